@@ -0,0 +1,33 @@
+#include "camera.h"
+#include "defs.h"
+#include "player.h"
+#include "utils.h"
+
+camera_t camera = {
+	DEFAULT_RENDER_WIDTH >> 1,
+	DEFAULT_RENDER_HEIGHT >> 1,
+	PI / 2,
+};
+
+camera_t getPlayerPose(void) {
+	camera_t pose = {player.x, player.y, player.rotationAngle};
+	return pose;
+}
+
+void setCameraToPlayer(void) {
+	camera = getPlayerPose();
+}
+
+void interpolateCamera(const camera_t *from, const camera_t *to, float alpha) {
+	float deltaAngle = to->angle - from->angle;
+	if (deltaAngle > PI) {
+		deltaAngle -= TWO_PI;
+	} else if (deltaAngle < -PI) {
+		deltaAngle += TWO_PI;
+	}
+
+	camera.x = from->x + (to->x - from->x) * alpha;
+	camera.y = from->y + (to->y - from->y) * alpha;
+	camera.angle = from->angle + deltaAngle * alpha;
+	normalizeAngle(&camera.angle);
+}
@@ -0,0 +1,20 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+// The pose the frame is rendered from. The simulation moves the player at a fixed tick rate,
+// the camera is interpolated between the last two ticks so motion stays smooth at any frame rate.
+typedef struct camera_t {
+	float x;
+	float y;
+	float angle;
+} camera_t;
+
+extern camera_t camera;
+
+camera_t getPlayerPose(void);
+void setCameraToPlayer(void);
+
+// Blends from -> to by alpha in [0, 1], the angle along the shortest arc
+void interpolateCamera(const camera_t *from, const camera_t *to, float alpha);
+
+#endif
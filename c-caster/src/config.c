@@ -0,0 +1,169 @@
+#include "config.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "graphics.h"
+#include "ray.h"
+
+config_t config = {
+	.renderWidth = DEFAULT_RENDER_WIDTH,
+	.renderHeight = DEFAULT_RENDER_HEIGHT,
+	.fov = DEFAULT_FOV,
+	.distProjPlane = 0,
+	.windowWidth = 0,
+	.windowHeight = 0,
+	.fullScreen = true,
+	.nativeResolution = false,
+	.vsync = true,
+	.dynamicResolution = false,
+	.targetFrameMs = DEFAULT_TARGET_FRAME_MS,
+	.minResolutionScale = DEFAULT_MIN_RESOLUTION_SCALE,
+	.threads = 0,
+	.textureBudgetMb = 0,
+	.indexedTextures = false,
+	.hotReload = false,
+	.mapFile = DEFAULT_MAP_FILE,
+	.mapBudgetMb = DEFAULT_MAP_BUDGET_MB,
+	.guards = 0,
+};
+
+static void updateProjection(void) {
+	// tan in double precision, rounded once: tanf can be an ulp off which shifts texture rows
+	config.distProjPlane = (config.renderWidth >> 1) / (float)tan(config.fov / 2);
+}
+
+int parseConfigOption(int argc, char *argv[], int i) {
+	const char *option = argv[i];
+	const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+	if (strcmp(option, "--windowed") == 0) {
+		config.fullScreen = false;
+		return 1;
+	}
+	if (strcmp(option, "--native") == 0) {
+		config.nativeResolution = true;
+		return 1;
+	}
+	if (strcmp(option, "--no-vsync") == 0) {
+		config.vsync = false;
+		return 1;
+	}
+	if (strcmp(option, "--indexed-textures") == 0) {
+		config.indexedTextures = true;
+		return 1;
+	}
+	if (strcmp(option, "--hot-reload") == 0) {
+		config.hotReload = true;
+		return 1;
+	}
+	if (strcmp(option, "--dynamic-resolution") == 0) {
+		config.dynamicResolution = true;
+		return 1;
+	}
+	if (strcmp(option, "--map") == 0) {
+		if (value == NULL) {
+			fprintf(stderr, "Missing value for %s\n", option);
+			return -1;
+		}
+		config.mapFile = value;
+		return 2;
+	}
+	if (strcmp(option, "--target-ms") == 0 || strcmp(option, "--min-scale") == 0) {
+		const float number = value != NULL ? atof(value) : 0;
+		const bool isScale = strcmp(option, "--min-scale") == 0;
+		if (number <= 0 || (isScale && number > 1)) {
+			fprintf(stderr, "Invalid value for %s\n", option);
+			return -1;
+		}
+		if (isScale) {
+			config.minResolutionScale = number;
+		} else {
+			config.targetFrameMs = number;
+		}
+		return 2;
+	}
+
+	int *intTarget = NULL;
+	int minimum = 0;
+	if (strcmp(option, "--width") == 0) {
+		intTarget = &config.renderWidth;
+		minimum = MIN_RENDER_WIDTH;
+	} else if (strcmp(option, "--height") == 0) {
+		intTarget = &config.renderHeight;
+		minimum = MIN_RENDER_HEIGHT;
+	} else if (strcmp(option, "--window-width") == 0) {
+		intTarget = &config.windowWidth;
+	} else if (strcmp(option, "--window-height") == 0) {
+		intTarget = &config.windowHeight;
+	} else if (strcmp(option, "--threads") == 0) {
+		intTarget = &config.threads;
+		minimum = 1;
+	} else if (strcmp(option, "--texture-budget") == 0) {
+		intTarget = &config.textureBudgetMb;
+		minimum = 1;
+	} else if (strcmp(option, "--guards") == 0) {
+		intTarget = &config.guards;
+		minimum = 1;
+	} else if (strcmp(option, "--map-budget") == 0) {
+		intTarget = &config.mapBudgetMb;
+		minimum = 1;
+	} else if (strcmp(option, "--fov") == 0) {
+		const float degrees = value != NULL ? atof(value) : 0;
+		if (degrees <= 0 || degrees >= 180) {
+			fprintf(stderr, "Invalid value for %s, expected degrees between 0 and 180\n", option);
+			return -1;
+		}
+		setFov(DEG_TO_RAD(degrees));
+		return 2;
+	} else {
+		return 0;
+	}
+
+	const int number = value != NULL ? atoi(value) : 0;
+	if (number < minimum || (minimum == 0 && number <= 0)) {
+		fprintf(stderr, "Invalid value for %s\n", option);
+		return -1;
+	}
+	*intTarget = number;
+	return 2;
+}
+
+void printConfigUsage(void) {
+	fprintf(stderr, "  --width N, --height N        internal render resolution (default %dx%d)\n", DEFAULT_RENDER_WIDTH, DEFAULT_RENDER_HEIGHT);
+	fprintf(stderr, "  --fov DEGREES                horizontal field of view (default 60)\n");
+	fprintf(stderr, "  --windowed                   resizable window instead of borderless full screen\n");
+	fprintf(stderr, "  --window-width N, --window-height N  window size when windowed\n");
+	fprintf(stderr, "  --native                     render at the window size, following resizes\n");
+	fprintf(stderr, "  --no-vsync                   render uncapped instead of at the display refresh rate\n");
+	fprintf(stderr, "  --dynamic-resolution         lower the render resolution when frames run over budget\n");
+	fprintf(stderr, "  --target-ms MS               cast plus rasterize budget per frame (default %.0f)\n", DEFAULT_TARGET_FRAME_MS);
+	fprintf(stderr, "  --threads N                  worker threads including the main thread (default one per CPU)\n");
+	fprintf(stderr, "  --texture-budget MB          evict the least recently used textures above MB of decoded texels (default unlimited)\n");
+	fprintf(stderr, "  --indexed-textures           keep decoded textures as 8-bit palette indices, a quarter of the memory\n");
+	fprintf(stderr, "  --map FILE                   level to play (default %s)\n", DEFAULT_MAP_FILE);
+	fprintf(stderr, "  --guards N                   spawn N patrolling guards around the player\n");
+	fprintf(stderr, "  --map-budget MB              map chunks kept in memory around the player (default %d)\n", DEFAULT_MAP_BUDGET_MB);
+	fprintf(stderr, "  --hot-reload                 reload textures and the map when their files change while running (Linux)\n");
+	fprintf(stderr, "  --min-scale F                lowest dynamic resolution scale (default %.2f)\n", DEFAULT_MIN_RESOLUTION_SCALE);
+}
+
+bool setRenderResolution(int width, int height) {
+	if (width < MIN_RENDER_WIDTH || height < MIN_RENDER_HEIGHT) {
+		return false;
+	}
+	if (!createRays(width) || !createColorBuffer(width, height)) {
+		fprintf(stderr, "Could not allocate buffers for %dx%d\n", width, height);
+		return false;
+	}
+	config.renderWidth = width;
+	config.renderHeight = height;
+	updateProjection();
+	return true;
+}
+
+void setFov(float fov) {
+	config.fov = fov;
+	updateProjection();
+}
@@ -0,0 +1,40 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+
+typedef struct config_t {
+	int renderWidth;		// internal resolution, one ray is cast per column
+	int renderHeight;
+	float fov;				// horizontal field of view in radians
+	float distProjPlane;	// derived from renderWidth and fov
+	int windowWidth;		// 0 uses the display size
+	int windowHeight;
+	bool fullScreen;		// borderless at the display size, otherwise a resizable window
+	bool nativeResolution;	// render at the window size and follow it when it is resized
+	bool vsync;				// pace presents to the display, otherwise render uncapped
+	bool dynamicResolution;	// let the governor scale the render resolution, see governor.h
+	float targetFrameMs;	// budget for casting plus rasterizing a frame
+	float minResolutionScale;
+	int threads;			// job threads including the main thread, 0 uses one per CPU
+	int textureBudgetMb;	// decoded textures kept on the heap, 0 keeps every texture
+	bool indexedTextures;	// quantize decoded textures to a palette, a byte per texel
+	bool hotReload;			// watch the assets and reload the ones that change while running
+	const char *mapFile;
+	int mapBudgetMb;		// map chunks kept in memory around the player
+	int guards;				// spawned around the player, see entity.h
+} config_t;
+
+extern config_t config;
+
+// Consumes the config option at argv[i] (and its value), returns the number of arguments
+// used, 0 if argv[i] is not a config option and -1 if its value is missing or invalid
+int parseConfigOption(int argc, char *argv[], int i);
+void printConfigUsage(void);
+
+// Resizes the color buffer and ray buffer and updates the projection. Returns false,
+// leaving the current resolution in place, if the size is invalid or allocation fails.
+bool setRenderResolution(int width, int height);
+void setFov(float fov);
+
+#endif
@@ -7,22 +7,40 @@
 
 #define TILE_SIZE 64
 
-#define WINDOW_WIDTH 1280
-#define WINDOW_HEIGHT 800
+// Defaults for the runtime configuration, see config.h
+#define DEFAULT_RENDER_WIDTH 1280
+#define DEFAULT_RENDER_HEIGHT 800
 
-#define FOV (60 * (PI / 180))
+#define DEFAULT_FOV (60 * (PI / 180))
 
-#define DIST_PROJ_PLANE ((WINDOW_WIDTH >> 1) / tanf(FOV / 2))
+#define MIN_RENDER_WIDTH 64
+#define MIN_RENDER_HEIGHT 48
+
+#define DEFAULT_TARGET_FRAME_MS (FRAME_TIME_LENGTH * 0.75f)
+#define DEFAULT_MIN_RESOLUTION_SCALE 0.5f
 
 #define MINIMAP_SCALE_FACTOR 0.2
 
+// Target frame rate, used as the frame budget by the profiler overlay and the governor
 #define FPS 30
 #define FRAME_TIME_LENGTH  (1000 / FPS)
 
+// The simulation runs at a fixed rate, rendering interpolates between ticks
+#define SIM_TICK_RATE 60
+#define SIM_TICK_LENGTH_NS (1000000000ULL / SIM_TICK_RATE)
+#define SIM_TICK_DELTA_TIME (1.0f / SIM_TICK_RATE)
+#define MAX_FRAME_TIME_NS 250000000ULL
+
 #define SDL_DEFAULT_DRIVER -1
 
 #define DEG_TO_RAD(deg) (deg) * (PI / 180)
 
-#define NUM_TEXTURES 14
+#define TEXTURE_PACK_FILE "./textures.pack"
+#define DEFAULT_MAP_FILE "./maps/level1.map"
+#define DEFAULT_MAP_BUDGET_MB 16
+#define GUARD_SEED 0x2545F491
+
+// Sprite texels of this color are not drawn
+#define TRANSPARENT_COLOR 0xFFFF00FF
 
 #endif
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "entity.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "graphics.h"
+#include "jobs.h"
+#include "map.h"
+#include "player.h"
+#include "profiler.h"
+#include "pvs.h"
+#include "utils.h"
+
+#define ENTITY_BATCH_SIZE 512
+#define GUARD_TEXTURE_FILE "./images/guard.png"
+#define GUARD_PATROL_SPEED 40.0f
+#define GUARD_CHASE_SPEED 80.0f
+#define GUARD_CHASE_DISTANCE (5.0f * TILE_SIZE)
+#define GUARD_STOP_DISTANCE (0.5f * TILE_SIZE)
+#define GUARD_SPAWN_RADIUS 32		// tiles around the player
+#define GUARD_SPAWN_TRIES 16
+
+entity_store_t entities;
+
+static uint32_t nextRandom(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+// Uniform in [0, 1)
+static float nextRandomFloat(uint32_t *state) {
+	return (nextRandom(state) >> 8) * (1.0f / (1 << 24));
+}
+
+static bool growEntities(int capacity) {
+	void **arrays[] = {
+		(void **)&entities.x, (void **)&entities.y, (void **)&entities.velocityX, (void **)&entities.velocityY,
+		(void **)&entities.facing, (void **)&entities.texture, (void **)&entities.state, (void **)&entities.stateTime,
+		(void **)&entities.random
+	};
+	const size_t sizes[] = {
+		sizeof(float), sizeof(float), sizeof(float), sizeof(float),
+		sizeof(float), sizeof(texture_handle_t), sizeof(uint8_t), sizeof(float),
+		sizeof(uint32_t)
+	};
+	// A failure leaves the arrays that did grow bigger than needed, which is harmless
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		void *grown = realloc(*arrays[i], capacity * sizes[i]);
+		if (grown == NULL) {
+			return false;
+		}
+		*arrays[i] = grown;
+	}
+	entities.capacity = capacity;
+	return true;
+}
+
+int spawnEntity(float x, float y, float facing, texture_handle_t texture) {
+	if (entities.count == entities.capacity && !growEntities(entities.capacity > 0 ? entities.capacity * 2 : 256)) {
+		fprintf(stderr, "Out of memory spawning entity %d\n", entities.count);
+		return -1;
+	}
+	const int i = entities.count++;
+	entities.x[i] = x;
+	entities.y[i] = y;
+	entities.velocityX[i] = 0;
+	entities.velocityY[i] = 0;
+	entities.facing[i] = facing;
+	entities.texture[i] = texture;
+	entities.state[i] = ENTITY_PATROL;
+	entities.stateTime[i] = 0;
+	// Never 0, which xorshift would keep forever
+	entities.random[i] = 0x9E3779B9u * (i + 1) | 1;
+	return i;
+}
+
+bool spawnGuards(int count, uint32_t seed) {
+	const texture_handle_t texture = findTexture(GUARD_TEXTURE_FILE);
+	const int playerCol = (int)floorf(player.x / TILE_SIZE);
+	const int playerRow = (int)floorf(player.y / TILE_SIZE);
+	const int minCol = playerCol > GUARD_SPAWN_RADIUS ? playerCol - GUARD_SPAWN_RADIUS : 0;
+	const int minRow = playerRow > GUARD_SPAWN_RADIUS ? playerRow - GUARD_SPAWN_RADIUS : 0;
+	const int maxCol = playerCol + GUARD_SPAWN_RADIUS < getMapNumCols() ? playerCol + GUARD_SPAWN_RADIUS : getMapNumCols() - 1;
+	const int maxRow = playerRow + GUARD_SPAWN_RADIUS < getMapNumRows() ? playerRow + GUARD_SPAWN_RADIUS : getMapNumRows() - 1;
+	uint32_t random = seed | 1;
+	int spawned = 0;
+	for (int tries = 0; spawned < count && tries < count * GUARD_SPAWN_TRIES && minCol <= maxCol && minRow <= maxRow; tries++) {
+		const int col = minCol + (int)(nextRandom(&random) % (maxCol - minCol + 1));
+		const int row = minRow + (int)(nextRandom(&random) % (maxRow - minRow + 1));
+		const float x = (col + 0.5f) * TILE_SIZE;
+		const float y = (row + 0.5f) * TILE_SIZE;
+		if (mapHasWallAt(x, y)) {
+			continue;
+		}
+		if (spawnEntity(x, y, nextRandomFloat(&random) * TWO_PI, texture) < 0) {
+			return false;
+		}
+		spawned++;
+	}
+	if (spawned < count) {
+		fprintf(stderr, "Only found room for %d of %d guards\n", spawned, count);
+	}
+	return true;
+}
+
+void freeEntities(void) {
+	free(entities.x);
+	free(entities.y);
+	free(entities.velocityX);
+	free(entities.velocityY);
+	free(entities.facing);
+	free(entities.texture);
+	free(entities.state);
+	free(entities.stateTime);
+	free(entities.random);
+	memset(&entities, 0, sizeof(entities));
+}
+
+typedef struct entity_update_t {
+	float deltaTime;
+	float playerX;
+	float playerY;
+	const uint8_t *visibleTiles;	// from the player's tile, see pvs.h
+} entity_update_t;
+
+static void turnTo(int i, float facing, float speed) {
+	normalizeAngle(&facing);
+	entities.facing[i] = facing;
+	entities.velocityX[i] = cosf(facing) * speed;
+	entities.velocityY[i] = sinf(facing) * speed;
+}
+
+// Each entity only reads the map, the player and the PVS and writes its own slots, so batches
+// never touch the same data
+static void updateEntityBatch(void *data, int batch) {
+	const uint64_t zoneStart = profileBegin();
+	const entity_update_t *update = data;
+	const float deltaTime = update->deltaTime;
+	const int end = (batch + 1) * ENTITY_BATCH_SIZE < entities.count ? (batch + 1) * ENTITY_BATCH_SIZE : entities.count;
+	for (int i = batch * ENTITY_BATCH_SIZE; i < end; i++) {
+		const float toPlayerX = update->playerX - entities.x[i];
+		const float toPlayerY = update->playerY - entities.y[i];
+		const float playerDistanceSquared = toPlayerX * toPlayerX + toPlayerY * toPlayerY;
+
+		// Only a guard in a tile the player may be seen from gives chase, sight goes both ways
+		if (playerDistanceSquared < GUARD_CHASE_DISTANCE * GUARD_CHASE_DISTANCE && isTileVisible(update->visibleTiles, entities.x[i], entities.y[i])) {
+			entities.state[i] = ENTITY_CHASE;
+			const float playerDistance = sqrtf(playerDistanceSquared);
+			const float speed = playerDistance > GUARD_STOP_DISTANCE ? GUARD_CHASE_SPEED / playerDistance : 0;
+			entities.velocityX[i] = toPlayerX * speed;
+			entities.velocityY[i] = toPlayerY * speed;
+			entities.facing[i] = atan2f(toPlayerY, toPlayerX);
+		} else {
+			if (entities.state[i] == ENTITY_CHASE) {
+				entities.state[i] = ENTITY_PATROL;
+				entities.stateTime[i] = 0;
+			}
+			entities.stateTime[i] -= deltaTime;
+			if (entities.stateTime[i] <= 0) {
+				const float turn = (nextRandomFloat(&entities.random[i]) - 0.5f) * PI;
+				turnTo(i, entities.facing[i] + turn, GUARD_PATROL_SPEED);
+				entities.stateTime[i] = 1 + 2 * nextRandomFloat(&entities.random[i]);
+			}
+		}
+
+		// Each axis on its own, so a guard slides along a wall instead of sticking to it
+		const float newX = entities.x[i] + entities.velocityX[i] * deltaTime;
+		const float newY = entities.y[i] + entities.velocityY[i] * deltaTime;
+		bool blocked = false;
+		if (!mapHasWallAt(newX, entities.y[i])) {
+			entities.x[i] = newX;
+		} else {
+			blocked = true;
+		}
+		if (!mapHasWallAt(entities.x[i], newY)) {
+			entities.y[i] = newY;
+		} else {
+			blocked = true;
+		}
+		if (blocked && entities.state[i] == ENTITY_PATROL) {
+			const float turn = PI + (nextRandomFloat(&entities.random[i]) - 0.5f) * (PI / 2);
+			turnTo(i, entities.facing[i] + turn, GUARD_PATROL_SPEED);
+			entities.stateTime[i] = 1 + 2 * nextRandomFloat(&entities.random[i]);
+		}
+	}
+	profileEnd(PROFILE_ENTITY_BATCH, zoneStart);
+}
+
+void updateEntities(float deltaTime) {
+	entity_update_t update = {deltaTime, player.x, player.y, getVisibleTiles(player.x, player.y)};
+	parallelFor((entities.count + ENTITY_BATCH_SIZE - 1) / ENTITY_BATCH_SIZE, updateEntityBatch, &update);
+}
+
+void renderMapEntities(void) {
+	for (int i = 0; i < entities.count; i++) {
+		drawRect(
+			entities.x[i] * MINIMAP_SCALE_FACTOR,
+			entities.y[i] * MINIMAP_SCALE_FACTOR,
+			2,
+			2,
+			entities.state[i] == ENTITY_CHASE ? 0xFF0000FF : 0xFF00AA00
+		);
+	}
+}
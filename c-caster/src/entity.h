@@ -0,0 +1,43 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "textures.h"
+
+typedef enum entity_state_t {
+	ENTITY_PATROL,	// walks straight, turns at walls and now and then
+	ENTITY_CHASE,	// walks at the player while they are close and may be in sight
+} entity_state_t;
+
+// Every moving object but the player, in structure of arrays: entity i is index i of every array,
+// so the update streams through only the fields it touches
+typedef struct entity_store_t {
+	int count;
+	int capacity;
+	float *x;
+	float *y;
+	float *velocityX;		// pixels per second
+	float *velocityY;
+	float *facing;			// radians
+	texture_handle_t *texture;
+	uint8_t *state;			// entity_state_t
+	float *stateTime;		// seconds until the next patrol turn
+	uint32_t *random;		// xorshift state, the update never shares one between entities
+} entity_store_t;
+
+extern entity_store_t entities;
+
+// Returns the new entity's index, -1 when out of memory
+int spawnEntity(float x, float y, float facing, texture_handle_t texture);
+// Spawns count guards on random empty tiles near the player, the same ones for the same seed.
+// Returns false when out of memory.
+bool spawnGuards(int count, uint32_t seed);
+void freeEntities(void);
+
+// Once per tick after the player moved: runs the AI and moves every entity, colliding with the
+// map, in batches across the job workers. The result does not depend on the number of workers.
+void updateEntities(float deltaTime);
+void renderMapEntities(void);
+
+#endif
@@ -0,0 +1,80 @@
+#include "governor.h"
+#include <math.h>
+#include "config.h"
+#include "defs.h"
+
+// Frames averaged before deciding, and frames to wait after a change so the new resolution
+// is measured before the next decision
+#define GOVERNOR_WINDOW 15
+#define GOVERNOR_COOLDOWN 30
+
+// Hysteresis: scale down as soon as the average exceeds the target, only scale back up once it
+// has been well below it for a whole window. Steps down are larger than steps up.
+#define GOVERNOR_UPPER_THRESHOLD 1.0f
+#define GOVERNOR_LOWER_THRESHOLD 0.7f
+#define GOVERNOR_MAX_STEP_DOWN 0.75f
+#define GOVERNOR_STEP_UP 1.05f
+
+static int maxWidth;
+static int maxHeight;
+static float scale = 1.0f;
+static float samples[GOVERNOR_WINDOW];
+static int numSamples = 0;
+static int cooldown = 0;
+
+void initResolutionGovernor(void) {
+	maxWidth = config.renderWidth;
+	maxHeight = config.renderHeight;
+	scale = 1.0f;
+	numSamples = 0;
+	cooldown = 0;
+}
+
+static void applyScale(float newScale) {
+	const float minScale = config.minResolutionScale;
+	newScale = newScale < minScale ? minScale : (newScale > 1.0f ? 1.0f : newScale);
+
+	// Keep the width even so the projection stays centered on a column boundary
+	int width = ((int)(maxWidth * newScale)) & ~1;
+	int height = maxHeight * newScale;
+	width = width < MIN_RENDER_WIDTH ? MIN_RENDER_WIDTH : width;
+	height = height < MIN_RENDER_HEIGHT ? MIN_RENDER_HEIGHT : height;
+
+	if ((width != config.renderWidth || height != config.renderHeight) && setRenderResolution(width, height)) {
+		scale = newScale;
+		cooldown = GOVERNOR_COOLDOWN;
+	}
+	numSamples = 0;
+}
+
+void updateResolutionGovernor(float castMs, float rasterMs) {
+	if (!config.dynamicResolution) {
+		return;
+	}
+	if (cooldown > 0) {
+		cooldown--;
+		return;
+	}
+
+	samples[numSamples++] = castMs + rasterMs;
+	if (numSamples < GOVERNOR_WINDOW) {
+		return;
+	}
+
+	float average = 0;
+	for (int i = 0; i < GOVERNOR_WINDOW; i++) {
+		average += samples[i];
+	}
+	average /= GOVERNOR_WINDOW;
+	numSamples = 0;
+
+	const float target = config.targetFrameMs;
+	if (average > target * GOVERNOR_UPPER_THRESHOLD && scale > config.minResolutionScale) {
+		// Cost is roughly proportional to the pixel count, i.e the square of the scale.
+		// Aim between the thresholds so the next window does not immediately scale back up.
+		float step = sqrtf(target * (GOVERNOR_UPPER_THRESHOLD + GOVERNOR_LOWER_THRESHOLD) / 2 / average);
+		applyScale(scale * (step < GOVERNOR_MAX_STEP_DOWN ? GOVERNOR_MAX_STEP_DOWN : step));
+	} else if (average < target * GOVERNOR_LOWER_THRESHOLD && scale < 1.0f) {
+		applyScale(scale * GOVERNOR_STEP_UP);
+	}
+}
@@ -0,0 +1,10 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+// Dynamic resolution: scales the render resolution between config.minResolutionScale and the
+// configured resolution so that ray casting plus rasterization stay within config.targetFrameMs.
+// The smaller frame is stretched over the window on present.
+void initResolutionGovernor(void);
+void updateResolutionGovernor(float castMs, float rasterMs);
+
+#endif
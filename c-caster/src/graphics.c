@@ -1,90 +1,69 @@
 #include "graphics.h"
 #include <math.h>
 #include <stdbool.h>
-#include <SDL2/SDL.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
 #include "defs.h"
 
-#define FULL_SCREEN 1
-
-static SDL_Window *window = NULL;
-static SDL_Renderer *renderer = NULL;
 static color_t *colorBuffer = NULL;
-static SDL_Texture *colorBufferTexture = NULL;
-
-bool initializeWindow(void) {
-	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
-		fprintf(stderr, "Error initializing SDL\n");
-		return false;
-	}
 
-	SDL_DisplayMode displayMode;
-	SDL_GetCurrentDisplayMode(0, &displayMode);
-
-	const int w = FULL_SCREEN ? displayMode.w : WINDOW_WIDTH;
-	const int h = FULL_SCREEN ? displayMode.h : WINDOW_HEIGHT;
-
-	window = SDL_CreateWindow(
-		"JayCaster", 
-		SDL_WINDOWPOS_CENTERED, 
-		SDL_WINDOWPOS_CENTERED, 
-		w, 
-		h, 
-		SDL_WINDOW_BORDERLESS
-	);
-	if (!window) {
-		fprintf(stderr, "Error creating sdl window SDL\n");
-		return false;
+// The buffer only grows, changing the resolution within its capacity is free
+static int bufferWidth = 0;
+static int bufferHeight = 0;
+static int bufferCapacity = 0;
+
+// (Re)sizes the color buffer, which is plain memory: window.c presents it when there is a window,
+// without one frames are rendered straight into memory.
+bool createColorBuffer(int width, int height) {
+	if (width * height > bufferCapacity) {
+	    // Allocate the total amount of bytes to hold our color buffer
+		color_t *buffer = (color_t *)calloc(width * height, sizeof(color_t));
+		if (buffer == NULL) {
+			return false;
+		}
+		free(colorBuffer);
+		colorBuffer = buffer;
+		bufferCapacity = width * height;
 	}
 
-	renderer = SDL_CreateRenderer(window, SDL_DEFAULT_DRIVER, 0);
-	if (!renderer) {
-		fprintf(stderr, "Error creating sdl renderer SDL\n");
-		return false;
-	}
-
-	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-
-    // Allocate the total amount of bytes to hold our color buffer
-	colorBuffer = (color_t *)calloc(WINDOW_WIDTH * WINDOW_HEIGHT, sizeof(color_t));
-	colorBufferTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, WINDOW_WIDTH, WINDOW_HEIGHT);
+	bufferWidth = width;
+	bufferHeight = height;
 	return true;
 }
 
-void renderColorBuffer(void) {
-	// Pitch = the amount of bytes per row
-	SDL_UpdateTexture(
-        colorBufferTexture, 
-        NULL, 
-        colorBuffer, 
-        (int) WINDOW_WIDTH * sizeof(color_t)
-    );
-	SDL_RenderCopy(renderer, colorBufferTexture, NULL, NULL);
-    SDL_RenderPresent(renderer);
+void destroyColorBuffer(void) {
+	free(colorBuffer);
+	colorBuffer = NULL;
+	bufferWidth = bufferHeight = bufferCapacity = 0;
+}
+
+color_t *getColorBuffer(void) {
+	return colorBuffer;
 }
 
 void clearColorBuffer(color_t clearColor) {
-	for (int i = 0; i < (WINDOW_WIDTH * WINDOW_HEIGHT); i++) {
+	for (int i = 0; i < (bufferWidth * bufferHeight); i++) {
 		colorBuffer[i] = clearColor;
 	}
 }
 
-void destroyWindow(void) {
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
-	SDL_DestroyTexture(colorBufferTexture);
-	free(colorBuffer);
-	SDL_Quit();
+void getColorBufferSize(int *width, int *height) {
+	*width = bufferWidth;
+	*height = bufferHeight;
 }
 
 void drawPixel(int x, int y, color_t color) {
-    colorBuffer[(WINDOW_WIDTH * y) + x] = color;
+    colorBuffer[(bufferWidth * y) + x] = color;
 }
 
+// Clipped to the color buffer, the mini-map and overlays may not fit at small resolutions
 void drawRect(int x, int y, int width, int height, color_t color) {
-    for (int i = x; i <= (x + width); i++) {
-        for (int j = y; j <= (y + height); j++) {
+    const int right = (x + width) < bufferWidth ? (x + width) : bufferWidth - 1;
+    const int bottom = (y + height) < bufferHeight ? (y + height) : bufferHeight - 1;
+    for (int i = x > 0 ? x : 0; i <= right; i++) {
+        for (int j = y > 0 ? y : 0; j <= bottom; j++) {
             drawPixel(i, j, color);
         }
     }
@@ -103,7 +82,11 @@ void drawLine(int x0, int y0, int x1, int y1, color_t color) {
     float currentY = y0;
 
     for (int i = 0; i < longestSideLength; i++) {
-        drawPixel(round(currentX), round(currentY), color);
+        const int x = round(currentX);
+        const int y = round(currentY);
+        if (x >= 0 && x < bufferWidth && y >= 0 && y < bufferHeight) {
+            drawPixel(x, y, color);
+        }
         currentX += xIncrement;
         currentY += yIncrement;
     }
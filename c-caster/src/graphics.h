@@ -6,10 +6,11 @@
 
 typedef uint32_t color_t; 
 
-bool initializeWindow(void);
-void renderColorBuffer(void);
+bool createColorBuffer(int width, int height);
+void destroyColorBuffer(void);
+color_t *getColorBuffer(void);
+void getColorBufferSize(int *width, int *height);
 void clearColorBuffer(color_t clearColor);
-void destroyWindow(void);
 void drawPixel(int x, int y, color_t color);
 void drawRect(int x, int y, int w, int h, color_t color);
 
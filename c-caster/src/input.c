@@ -0,0 +1,204 @@
+#include "input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "player.h"
+
+#define INPUT_LOG_MAGIC "RCIN"
+#define INPUT_LOG_VERSION 2
+#define INPUT_LOG_MAX_RUN 255
+
+static bool keyStates[NUM_INPUT_KEYS];
+static int8_t usedLastTick = 0;		// use opens a door once per press, not on every tick it is held
+
+void setKeyState(input_key_t key, bool down) {
+	keyStates[key] = down;
+}
+
+void clearKeyStates(void) {
+	memset(keyStates, 0, sizeof(keyStates));
+	resetUseEdge();
+}
+
+void resetUseEdge(void) {
+	usedLastTick = 0;
+}
+
+tick_input_t resolveTickInput(void) {
+	tick_input_t input = {
+		keyStates[INPUT_KEY_UP] - keyStates[INPUT_KEY_DOWN],
+		keyStates[INPUT_KEY_RIGHT] - keyStates[INPUT_KEY_LEFT],
+		keyStates[INPUT_KEY_USE]
+	};
+	return input;
+}
+
+void applyTickInput(tick_input_t input) {
+	player.walkDirection = input.walkDirection;
+	player.turnDirection = input.turnDirection;
+
+	if (input.use && !usedLastTick) {
+		useDoorAhead();
+	}
+	usedLastTick = input.use;
+}
+
+// Both directions fit in two bits each, use in the bit above. Logs from before use had it clear.
+static uint8_t packTickInput(tick_input_t input) {
+	return (input.walkDirection + 1) | (input.turnDirection + 1) << 2 | input.use << 4;
+}
+
+static bool unpackTickInput(uint8_t packed, tick_input_t *input) {
+	const int walk = packed & 3;
+	const int turn = (packed >> 2) & 3;
+	const int use = packed >> 4;
+	if (walk > 2 || turn > 2 || use > 1) {
+		return false;
+	}
+	input->walkDirection = walk - 1;
+	input->turnDirection = turn - 1;
+	input->use = use;
+	return true;
+}
+
+static bool pushRun(input_log_t *log, tick_input_t input, int ticks) {
+	if (log->numRuns == log->capacity) {
+		const int capacity = log->capacity > 0 ? log->capacity * 2 : 256;
+		input_run_t *runs = realloc(log->runs, capacity * sizeof(input_run_t));
+		if (runs == NULL) {
+			return false;
+		}
+		log->runs = runs;
+		log->capacity = capacity;
+	}
+	log->runs[log->numRuns].input = input;
+	log->runs[log->numRuns].ticks = ticks;
+	log->numRuns++;
+	log->numTicks += ticks;
+	return true;
+}
+
+bool appendTickInput(input_log_t *log, tick_input_t input) {
+	if (log->numRuns > 0) {
+		input_run_t *last = &log->runs[log->numRuns - 1];
+		if (last->input.walkDirection == input.walkDirection && last->input.turnDirection == input.turnDirection && last->input.use == input.use && last->ticks < INPUT_LOG_MAX_RUN) {
+			last->ticks++;
+			log->numTicks++;
+			return true;
+		}
+	}
+	return pushRun(log, input, 1);
+}
+
+bool nextTickInput(const input_log_t *log, input_cursor_t *cursor, tick_input_t *input) {
+	while (cursor->run < log->numRuns && cursor->tick >= log->runs[cursor->run].ticks) {
+		cursor->run++;
+		cursor->tick = 0;
+	}
+	if (cursor->run == log->numRuns) {
+		return false;
+	}
+	*input = log->runs[cursor->run].input;
+	cursor->tick++;
+	return true;
+}
+
+// Little-endian on every machine, so a log replays wherever it was recorded
+static void writeFloat(FILE *file, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 4; i++) {
+		fputc(bits >> (8 * i) & 0xFF, file);
+	}
+}
+
+static bool readFloat(FILE *file, float *value) {
+	uint32_t bits = 0;
+	for (int i = 0; i < 4; i++) {
+		const int byte = fgetc(file);
+		if (byte == EOF) {
+			return false;
+		}
+		bits |= (uint32_t)byte << (8 * i);
+	}
+	memcpy(value, &bits, sizeof(bits));
+	return true;
+}
+
+bool saveInputLog(const char *fileName, const input_log_t *log) {
+	FILE *file = fopen(fileName, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not write input log=%s\n", fileName);
+		return false;
+	}
+	fwrite(INPUT_LOG_MAGIC, 1, 4, file);
+	fputc(INPUT_LOG_VERSION, file);
+	fputc(SIM_TICK_RATE, file);
+	writeFloat(file, log->startX);
+	writeFloat(file, log->startY);
+	writeFloat(file, log->startAngle);
+	for (int i = 0; i < log->numRuns; i++) {
+		fputc(packTickInput(log->runs[i].input), file);
+		fputc(log->runs[i].ticks, file);
+	}
+	const bool written = !ferror(file);
+	fclose(file);
+	return written;
+}
+
+bool loadInputLog(const char *fileName, input_log_t *log) {
+	memset(log, 0, sizeof(*log));
+	FILE *file = fopen(fileName, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not open input log=%s\n", fileName);
+		return false;
+	}
+
+	char magic[4];
+	if (fread(magic, 1, 4, file) != 4 || memcmp(magic, INPUT_LOG_MAGIC, 4) != 0) {
+		fprintf(stderr, "Not an input log=%s\n", fileName);
+		fclose(file);
+		return false;
+	}
+	if (fgetc(file) != INPUT_LOG_VERSION) {
+		fprintf(stderr, "Input log=%s was written by another version, record it again\n", fileName);
+		fclose(file);
+		return false;
+	}
+	// Replaying at another tick rate would not reproduce the recorded motion
+	if (fgetc(file) != SIM_TICK_RATE) {
+		fprintf(stderr, "Input log=%s was recorded at another tick rate\n", fileName);
+		fclose(file);
+		return false;
+	}
+	if (!readFloat(file, &log->startX) || !readFloat(file, &log->startY) || !readFloat(file, &log->startAngle)) {
+		fprintf(stderr, "Malformed input log=%s\n", fileName);
+		fclose(file);
+		return false;
+	}
+
+	int packed;
+	while ((packed = fgetc(file)) != EOF) {
+		const int ticks = fgetc(file);
+		tick_input_t input;
+		if (ticks == EOF || ticks == 0 || !unpackTickInput(packed, &input)) {
+			fprintf(stderr, "Malformed input log=%s\n", fileName);
+			fclose(file);
+			freeInputLog(log);
+			return false;
+		}
+		if (!pushRun(log, input, ticks)) {
+			fclose(file);
+			freeInputLog(log);
+			return false;
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+void freeInputLog(input_log_t *log) {
+	free(log->runs);
+	memset(log, 0, sizeof(*log));
+}
@@ -0,0 +1,61 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum input_key_t {
+	INPUT_KEY_UP,
+	INPUT_KEY_DOWN,
+	INPUT_KEY_LEFT,
+	INPUT_KEY_RIGHT,
+	INPUT_KEY_USE,
+	NUM_INPUT_KEYS
+} input_key_t;
+
+// Movement for one simulation tick, resolved from the keys held down at that tick
+typedef struct tick_input_t {
+	int8_t walkDirection; // -1 back, +1 forward
+	int8_t turnDirection; // -1 left, +1 right
+	int8_t use;           // 1 while the use key is held
+} tick_input_t;
+
+// Every event updates the table, so opposing keys cancel out instead of the last press winning
+void setKeyState(input_key_t key, bool down);
+void clearKeyStates(void);
+// Forgets whether use was held last tick, so a key held into a new map or session counts as a press
+void resetUseEdge(void);
+tick_input_t resolveTickInput(void);
+void applyTickInput(tick_input_t input);
+
+// Tick inputs are stored as runs of identical inputs, a held key costs a few bytes per second.
+// On disk: "RCIN", a version byte, the tick rate byte, the player's pose when recording began as
+// three little-endian floats (x, y, angle), then two bytes per run (input, ticks).
+typedef struct input_run_t {
+	tick_input_t input;
+	int ticks;
+} input_run_t;
+
+typedef struct input_log_t {
+	input_run_t *runs;
+	int numRuns;
+	int capacity;
+	int numTicks;
+	float startX;		// the pose the input was recorded from, a replay starts there
+	float startY;
+	float startAngle;
+} input_log_t;
+
+typedef struct input_cursor_t {
+	int run;
+	int tick;
+} input_cursor_t;
+
+bool appendTickInput(input_log_t *log, tick_input_t input);
+// Returns false once the whole log has been played
+bool nextTickInput(const input_log_t *log, input_cursor_t *cursor, tick_input_t *input);
+bool saveInputLog(const char *fileName, const input_log_t *log);
+bool loadInputLog(const char *fileName, input_log_t *log);
+void freeInputLog(input_log_t *log);
+
+#endif
@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "jobs.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static pthread_t workers[MAX_JOB_THREADS];
+static int numWorkers = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workDone = PTHREAD_COND_INITIALIZER;
+static uint64_t generation = 0;
+static int busyWorkers = 0;
+static bool stopping = false;
+
+// The current loop, indices are handed out one at a time so uneven jobs balance themselves
+static job_func_t jobFunc;
+static void *jobData;
+static int jobCount;
+static int nextIndex;
+
+static void runJobs(void) {
+	int index;
+	while ((index = __atomic_fetch_add(&nextIndex, 1, __ATOMIC_RELAXED)) < jobCount) {
+		jobFunc(jobData, index);
+	}
+}
+
+static void *workerMain(void *arg) {
+	(void)arg;
+	uint64_t seenGeneration = 0;
+
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		while (!stopping && generation == seenGeneration) {
+			pthread_cond_wait(&workReady, &lock);
+		}
+		if (stopping) {
+			break;
+		}
+		seenGeneration = generation;
+		pthread_mutex_unlock(&lock);
+
+		runJobs();
+
+		pthread_mutex_lock(&lock);
+		if (--busyWorkers == 0) {
+			pthread_cond_signal(&workDone);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+bool startJobWorkers(int numThreads) {
+	if (numThreads <= 0) {
+		numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (numThreads > MAX_JOB_THREADS) {
+		numThreads = MAX_JOB_THREADS;
+	}
+
+	stopping = false;
+	while (numWorkers < numThreads - 1) {
+		if (pthread_create(&workers[numWorkers], NULL, workerMain, NULL) != 0) {
+			fprintf(stderr, "Could not start job worker, continuing with %d threads\n", numWorkers + 1);
+			return false;
+		}
+		numWorkers++;
+	}
+	return true;
+}
+
+void stopJobWorkers(void) {
+	pthread_mutex_lock(&lock);
+	stopping = true;
+	pthread_cond_broadcast(&workReady);
+	pthread_mutex_unlock(&lock);
+
+	for (int i = 0; i < numWorkers; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	numWorkers = 0;
+}
+
+int getJobThreadCount(void) {
+	return numWorkers + 1;
+}
+
+void parallelFor(int count, job_func_t func, void *data) {
+	if (numWorkers == 0 || count <= 1) {
+		for (int i = 0; i < count; i++) {
+			func(data, i);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	jobFunc = func;
+	jobData = data;
+	jobCount = count;
+	nextIndex = 0;
+	busyWorkers = numWorkers;
+	generation++;
+	pthread_cond_broadcast(&workReady);
+	pthread_mutex_unlock(&lock);
+
+	runJobs();
+
+	// Every worker has to check in, so none of them is still looking at this loop when the next starts
+	pthread_mutex_lock(&lock);
+	while (busyWorkers > 0) {
+		pthread_cond_wait(&workDone, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,21 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+
+#define MAX_JOB_THREADS 64
+
+// A fixed pool of worker threads for data parallel loops. The calling thread works along,
+// so a pool of one thread (or a failed start) simply runs everything inline.
+typedef void (*job_func_t)(void *data, int index);
+
+// numThreads counts the calling thread, 0 or less uses one thread per online CPU
+bool startJobWorkers(int numThreads);
+void stopJobWorkers(void);
+int getJobThreadCount(void);
+
+// Calls func(data, i) for every i in [0, count) across the pool and returns once all of them
+// are done. Only one loop runs at a time, func must not start another one.
+void parallelFor(int count, job_func_t func, void *data);
+
+#endif
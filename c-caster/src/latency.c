@@ -0,0 +1,75 @@
+#include "latency.h"
+#include <stdlib.h>
+#include "profiler.h"
+
+#define MAX_PENDING_INPUTS 64
+#define LATENCY_HISTORY 1024
+
+// Drained but not yet consumed by a tick, and consumed but not yet presented
+static uint64_t pendingInputs[MAX_PENDING_INPUTS];
+static int numPendingInputs = 0;
+static uint64_t inFlightInputs[MAX_PENDING_INPUTS];
+static int numInFlightInputs = 0;
+
+static float history[LATENCY_HISTORY];
+static int numSamples = 0;
+static int nextSample = 0;
+
+void markInputEvent(uint64_t timestamp) {
+	if (numPendingInputs < MAX_PENDING_INPUTS) {
+		pendingInputs[numPendingInputs++] = timestamp;
+	}
+}
+
+void markInputConsumed(void) {
+	for (int i = 0; i < numPendingInputs && numInFlightInputs < MAX_PENDING_INPUTS; i++) {
+		inFlightInputs[numInFlightInputs++] = pendingInputs[i];
+	}
+	numPendingInputs = 0;
+}
+
+void markFramePresented(uint64_t timestamp) {
+	for (int i = 0; i < numInFlightInputs; i++) {
+		const uint64_t inputTime = inFlightInputs[i] < timestamp ? inFlightInputs[i] : timestamp;
+		profileInputLatency(inputTime, timestamp);
+		history[nextSample] = (timestamp - inputTime) / 1e6f;
+		nextSample = (nextSample + 1) % LATENCY_HISTORY;
+		if (numSamples < LATENCY_HISTORY) {
+			numSamples++;
+		}
+	}
+	numInFlightInputs = 0;
+}
+
+static int compareMs(const void *elem1, const void *elem2) {
+	const float a = *(const float *)elem1;
+	const float b = *(const float *)elem2;
+	return (a > b) - (a < b);
+}
+
+bool getInputLatencyStats(latency_stats_t *stats) {
+	if (numSamples == 0) {
+		return false;
+	}
+
+	float sorted[LATENCY_HISTORY];
+	double sum = 0;
+	for (int i = 0; i < numSamples; i++) {
+		sorted[i] = history[i];
+		sum += history[i];
+	}
+	qsort(sorted, numSamples, sizeof(float), compareMs);
+
+	stats->count = numSamples;
+	stats->meanMs = sum / numSamples;
+	stats->p99Ms = sorted[(numSamples * 99 + 99) / 100 - 1];
+	stats->maxMs = sorted[numSamples - 1];
+	return true;
+}
+
+void resetInputLatency(void) {
+	numPendingInputs = 0;
+	numInFlightInputs = 0;
+	numSamples = 0;
+	nextSample = 0;
+}
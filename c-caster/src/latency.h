@@ -0,0 +1,24 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Input-to-photon latency. Input events are stamped when they arrive, handed to the first
+// simulation tick that consumes them and closed once the frame rendering that tick is presented.
+void markInputEvent(uint64_t timestamp);
+void markInputConsumed(void);
+void markFramePresented(uint64_t timestamp);
+
+typedef struct latency_stats_t {
+	int count;
+	float meanMs;
+	float p99Ms;
+	float maxMs;
+} latency_stats_t;
+
+// Stats over the most recent inputs, returns false when none has been presented yet
+bool getInputLatencyStats(latency_stats_t *stats);
+void resetInputLatency(void);
+
+#endif
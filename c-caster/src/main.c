@@ -1,114 +1,386 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_video.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "camera.h"
+#include "config.h"
 #include "defs.h"
+#include "governor.h"
 #include "graphics.h"
+#include "input.h"
+#include "jobs.h"
+#include "latency.h"
 #include "player.h"
 #include "ray.h"
 #include "sprite.h"
 #include "textures.h"
 #include <stdbool.h>
+#include "entity.h"
 #include "map.h"
+#include "profiler.h"
+#include "timer.h"
 #include "wall.h"
+#include "watcher.h"
+#include "window.h"
 
 
 static bool isGameRunning = false;
-static uint32_t ticksLastFrame;
+static uint64_t timeLastFrame;
+static uint64_t tickAccumulator = 0;
+static camera_t previousPose;
+static const char *traceFileName = NULL;
+static int traceCaptureCount = 0;
+static const char *recordFileName = NULL;
+static const char *replayFileName = NULL;
+static input_log_t inputLog;
+static input_cursor_t replayCursor;
 
-static void setup(void) {
-	loadTextures();
+// Synthetic input: the turn key is pressed and released once per period, each event stamped
+// with the time it was due rather than when the frame loop got around to queueing it
+#define MAX_INJECTED_EVENTS 16
+// Real key events carry the small id of our window, so a real right arrow never takes a stamp
+#define INJECTED_WINDOW_ID UINT32_MAX
+static uint64_t injectPeriodNs = 0;
+static uint64_t nextInjectionTime;
+static bool injectedKeyDown = false;
+static uint64_t injectedTimes[MAX_INJECTED_EVENTS];
+static int injectedHead = 0;
+static int injectedTail = 0;
+
+static bool setup(void) {
+	int width = config.renderWidth;
+	int height = config.renderHeight;
+	if (config.nativeResolution) {
+		getWindowSize(&width, &height);
+	}
+	if (!setRenderResolution(width, height)) {
+		return false;
+	}
+	initResolutionGovernor();
+	startJobWorkers(config.threads);
+	if (!loadTextures() || !loadMap(config.mapFile, false)) {
+		return false;
+	}
+	// A replay starts from the pose its recording did, before the guards spawn around it
+	if (replayFileName != NULL) {
+		if (!loadInputLog(replayFileName, &inputLog)) {
+			return false;
+		}
+		player.x = inputLog.startX;
+		player.y = inputLog.startY;
+		player.rotationAngle = inputLog.startAngle;
+	} else if (recordFileName != NULL) {
+		inputLog.startX = player.x;
+		inputLog.startY = player.y;
+		inputLog.startAngle = player.rotationAngle;
+	}
+	if (!createSprites() || !spawnGuards(config.guards, GUARD_SEED)) {
+		return false;
+	}
+	if (config.hotReload) {
+		watchFile(config.mapFile);
+	}
+
+	previousPose = getPlayerPose();
+	setCameraToPlayer();
+	timeLastFrame = getTimestampNs();
+	nextInjectionTime = timeLastFrame + injectPeriodNs;
+	return true;
+}
+
+static void captureProfilerTrace(void) {
+	char fileName[64];
+	snprintf(fileName, sizeof(fileName), "raycast-trace-%d.json", ++traceCaptureCount);
+	if (exportProfilerTrace(fileName)) {
+		printf("Profiler trace written to %s\n", fileName);
+	}
+}
+
+static bool mapInputKey(SDL_Keycode sym, input_key_t *key) {
+	switch (sym) {
+		case SDLK_UP: *key = INPUT_KEY_UP; return true;
+		case SDLK_DOWN: *key = INPUT_KEY_DOWN; return true;
+		case SDLK_LEFT: *key = INPUT_KEY_LEFT; return true;
+		case SDLK_RIGHT: *key = INPUT_KEY_RIGHT; return true;
+		case SDLK_SPACE: *key = INPUT_KEY_USE; return true;
+		default: return false;
+	}
+}
+
+static void injectSyntheticInput(void) {
+	const uint64_t now = getTimestampNs();
+	if (injectPeriodNs == 0 || now < nextInjectionTime || (injectedTail + 1) % MAX_INJECTED_EVENTS == injectedHead) {
+		return;
+	}
+	SDL_Event event;
+	memset(&event, 0, sizeof(event));
+	injectedKeyDown = !injectedKeyDown;
+	event.type = injectedKeyDown ? SDL_KEYDOWN : SDL_KEYUP;
+	event.key.keysym.sym = SDLK_RIGHT;
+	event.key.windowID = INJECTED_WINDOW_ID;
+	if (SDL_PushEvent(&event) == 1) {
+		injectedTimes[injectedTail] = nextInjectionTime;
+		injectedTail = (injectedTail + 1) % MAX_INJECTED_EVENTS;
+	}
+	nextInjectionTime += injectPeriodNs;
+}
+
+// SDL stamps events in milliseconds on its own clock, this moves the stamp onto ours
+static uint64_t getEventTimestamp(const SDL_Event *event, uint64_t drainTime) {
+	if (injectedHead != injectedTail && event->key.windowID == INJECTED_WINDOW_ID) {
+		const uint64_t timestamp = injectedTimes[injectedHead];
+		injectedHead = (injectedHead + 1) % MAX_INJECTED_EVENTS;
+		return timestamp;
+	}
+	const int32_t age = (int32_t)(SDL_GetTicks() - event->common.timestamp);
+	return age > 0 ? drainTime - (uint64_t)age * 1000000 : drainTime;
+}
+
+// During a replay the keyboard does not move the player, so there is nothing to measure
+static void trackInputEvent(const SDL_Event *event, uint64_t drainTime) {
+	const uint64_t timestamp = getEventTimestamp(event, drainTime);
+	if (replayFileName == NULL) {
+		markInputEvent(timestamp);
+	}
 }
 
 static void processInput(void) {
 	SDL_Event event;
-	SDL_PollEvent(&event);
+	input_key_t key;
+	const uint64_t drainTime = getTimestampNs();
 
-	switch(event.type) {
-		case SDL_QUIT: {
-			isGameRunning = false;
-			break;
-		}
-		case SDL_KEYDOWN: {
-			const SDL_Keycode sym = event.key.keysym.sym;	
-			if (sym == SDLK_UP) {
-				player.walkDirection = 1;
+	// Drain everything that queued up since the last frame, movement only lands in the key table
+	while (SDL_PollEvent(&event)) {
+		switch(event.type) {
+			case SDL_QUIT: {
+				isGameRunning = false;
+				break;
 			}
-			if (sym == SDLK_DOWN) {
-				player.walkDirection = -1;
+			case SDL_WINDOWEVENT: {
+				if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED && config.nativeResolution) {
+					setRenderResolution(event.window.data1, event.window.data2);
+					initResolutionGovernor();
+				}
+				// Key ups go to whichever window has focus now
+				if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+					clearKeyStates();
+				}
+				break;
 			}
-			if (sym == SDLK_RIGHT) {
-				player.turnDirection = 1;
+			case SDL_KEYDOWN: {
+				if (mapInputKey(event.key.keysym.sym, &key) && !event.key.repeat) {
+					setKeyState(key, true);
+					trackInputEvent(&event, drainTime);
+				}
+				break;
 			}
-			if (sym == SDLK_LEFT) {
-				player.turnDirection = -1;
+			case SDL_KEYUP: {
+				const SDL_Keycode sym = event.key.keysym.sym;
+				if (mapInputKey(sym, &key)) {
+					setKeyState(key, false);
+					trackInputEvent(&event, drainTime);
+				}
+				if (sym == SDLK_ESCAPE) {
+					isGameRunning = false;
+				}
+				if (sym == SDLK_F1) {
+					toggleProfilerOverlay();
+				}
+				if (sym == SDLK_F2) {
+					captureProfilerTrace();
+				}
+				break;
 			}
-			break;
 		}
-		case SDL_KEYUP: {
-			const SDL_Keycode sym = event.key.keysym.sym;	
-			if (event.key.keysym.sym == SDLK_ESCAPE) {
-				isGameRunning = false;
-			}
-			if (sym == SDLK_UP || sym == SDLK_DOWN) {
-				player.walkDirection = 0;
-			}
-			if (sym == SDLK_RIGHT || sym == SDLK_LEFT) {
-				player.turnDirection = 0;
+	}
+}
+
+// Assets saved since the last frame, a changed map replaces the current one before the frame uses it
+static void reloadChangedAssets(void) {
+	char fileName[MAX_WATCH_PATH];
+	while (nextChangedFile(fileName, sizeof(fileName))) {
+		if (strcmp(fileName, config.mapFile) == 0) {
+			if (loadMap(config.mapFile, true)) {
+				createSprites();
 			}
-			break;
+		} else {
+			reloadTexture(fileName);
 		}
-
 	}
 }
 
+// The input for the next tick comes from the replay when one is playing, the keyboard otherwise
+static bool nextInput(tick_input_t *input) {
+	if (replayFileName != NULL) {
+		return nextTickInput(&inputLog, &replayCursor, input);
+	}
+	*input = resolveTickInput();
+	if (recordFileName != NULL && !appendTickInput(&inputLog, *input)) {
+		fprintf(stderr, "Out of memory recording input, recording stopped\n");
+		recordFileName = NULL;
+	}
+	return true;
+}
 
 static void update(void) {
-	// Wait some time until the reach the target frame time in milliseconds
-	int time_to_wait = FRAME_TIME_LENGTH - (SDL_GetTicks() - ticksLastFrame);
+	const uint64_t now = getTimestampNs();
+	uint64_t frameTime = now - timeLastFrame;
+	timeLastFrame = now;
 
-	// Only delay execution if we are running too fast
-	if (time_to_wait > 0 && time_to_wait <= FRAME_TIME_LENGTH) {
-		SDL_Delay(time_to_wait);
+	// After a stall (debugger, window drag) drop the backlog instead of simulating it in one frame
+	if (frameTime > MAX_FRAME_TIME_NS) {
+		frameTime = MAX_FRAME_TIME_NS;
 	}
-	float deltaTime = (SDL_GetTicks() - ticksLastFrame) / 1000.0f;
-	ticksLastFrame = SDL_GetTicks();
+	tickAccumulator += frameTime;
 
-	// Update all game objects
-	movePlayer(deltaTime);
+	// Update all game objects at a fixed rate, independent of how fast we render
+	uint64_t zoneStart = profileBegin();
+	while (tickAccumulator >= SIM_TICK_LENGTH_NS) {
+		tick_input_t input;
+		if (!nextInput(&input)) {
+			isGameRunning = false;
+			break;
+		}
+		markInputConsumed();
+		previousPose = getPlayerPose();
+		applyTickInput(input);
+		movePlayer(SIM_TICK_DELTA_TIME);
+		updateDoors();
+		const uint64_t entitiesStart = profileBegin();
+		updateEntities(SIM_TICK_DELTA_TIME);
+		profileEnd(PROFILE_UPDATE_ENTITIES, entitiesStart);
+		tickAccumulator -= SIM_TICK_LENGTH_NS;
+	}
+	profileEnd(PROFILE_MOVE_PLAYER, zoneStart);
+
+	// Render in between the last two ticks, the leftover time says how far along we are
+	const camera_t currentPose = getPlayerPose();
+	interpolateCamera(&previousPose, &currentPose, (float)tickAccumulator / SIM_TICK_LENGTH_NS);
+
+	// Take in the map chunks streamed since the last frame before the rays cross them
+	updateMapChunks(player.x, player.y);
+
+	zoneStart = profileBegin();
 	castAllRays();
+	profileEnd(PROFILE_CAST_ALL_RAYS, zoneStart);
 }
 
 static void render(void) {
+	// Take in the textures streamed since the last frame before anything samples them
+	updateTextureCache();
+
+	uint64_t zoneStart = profileBegin();
 	clearColorBuffer(0xFF000000);
+	profileEnd(PROFILE_CLEAR, zoneStart);
 
 	// Render walls and sprites
+	zoneStart = profileBegin();
 	renderWallProjection();
+	profileEnd(PROFILE_WALL_PROJECTION, zoneStart);
+
+	zoneStart = profileBegin();
 	renderSpriteProjection();
+	profileEnd(PROFILE_SPRITE_PROJECTION, zoneStart);
 
 	// Render mini-map objects
+	zoneStart = profileBegin();
 	renderMapGrid();
 	renderMapRays();
 	renderMapPlayer();
 	renderMapSprites();
-	
+	renderMapEntities();
+	profileEnd(PROFILE_MINIMAP, zoneStart);
 
+	renderProfilerOverlay();
+
+	zoneStart = profileBegin();
 	renderColorBuffer();
+	profileEnd(PROFILE_PRESENT, zoneStart);
+	markFramePresented(getTimestampNs());
 }
 
 
 static void releaseResources(void) {
+	latency_stats_t latency;
+	if (getInputLatencyStats(&latency)) {
+		printf("Input latency over the last %d inputs: mean %.2f ms, p99 %.2f ms, max %.2f ms\n", latency.count, latency.meanMs, latency.p99Ms, latency.maxMs);
+	}
+	if (traceFileName != NULL) {
+		exportProfilerTrace(traceFileName);
+	}
+	if (recordFileName != NULL && saveInputLog(recordFileName, &inputLog)) {
+		printf("Recorded %d ticks of input to %s\n", inputLog.numTicks, recordFileName);
+	}
+	texture_cache_stats_t textureStats;
+	getTextureCacheStats(&textureStats);
+	if (textureStats.budgetBytes > 0) {
+		printf("Texture cache: %d of %d textures resident, peak %.2f of %.0f MB, %d evictions\n", textureStats.numResident, textureStats.numTextures, textureStats.peakBytes / 1048576.0, textureStats.budgetBytes / 1048576.0, textureStats.numEvictions);
+	}
+	map_chunk_stats_t chunkStats;
+	getMapChunkStats(&chunkStats);
+	if (chunkStats.numChunks > chunkStats.numSlots) {
+		printf("Map chunks: %d of %d resident in %d slots, %d loads, %d evictions\n", chunkStats.numResident, chunkStats.numChunks, chunkStats.numSlots, chunkStats.numLoads, chunkStats.numEvictions);
+	}
+	freeInputLog(&inputLog);
+	freeEntities();
+	freeSprites();
+	freeMap();
 	freeTextures();
+	freeRays();
+	stopJobWorkers();
 	destroyWindow();
-	SDL_Quit();
 }
 
-int main() {
-	isGameRunning = initializeWindow();
-	setup();
+static void printUsage(void) {
+	fprintf(stderr, "Usage: raycast [options]\n");
+	printConfigUsage();
+	fprintf(stderr, "  --trace FILE                 write the profiler capture to FILE on exit\n");
+	fprintf(stderr, "  --record FILE                record the input of every simulation tick to FILE\n");
+	fprintf(stderr, "  --replay FILE                play back recorded input instead of the keyboard, quits at its end\n");
+	fprintf(stderr, "  --inject-input MS            press or release the right arrow every MS milliseconds to measure input latency\n");
+}
+
+int main(int argc, char *argv[]) {
+	for (int i = 1; i < argc; i++) {
+		const int consumed = parseConfigOption(argc, argv, i);
+		if (consumed > 0) {
+			i += consumed - 1;
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			traceFileName = argv[++i];
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			recordFileName = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replayFileName = argv[++i];
+		} else if (strcmp(argv[i], "--inject-input") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			injectPeriodNs = atoi(argv[++i]) * 1000000ULL;
+		} else {
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	isGameRunning = initializeWindow() && setup();
 	while (isGameRunning) {
+		const uint64_t frameStart = profileBegin();
+
+		injectSyntheticInput();
+		if (config.hotReload) {
+			reloadChangedAssets();
+		}
+		uint64_t zoneStart = profileBegin();
 		processInput();
+		profileEnd(PROFILE_PROCESS_INPUT, zoneStart);
+
 		update();
 		render();
+
+		profileEnd(PROFILE_FRAME, frameStart);
+		profilerEndFrame();
+
+		const float castMs = getLastFrameZoneMs(PROFILE_CAST_ALL_RAYS);
+		const float rasterMs = getLastFrameZoneMs(PROFILE_CLEAR) + getLastFrameZoneMs(PROFILE_WALL_PROJECTION) + getLastFrameZoneMs(PROFILE_SPRITE_PROJECTION);
+		updateResolutionGovernor(castMs, rasterMs);
 	}
 	releaseResources();
 	return EXIT_SUCCESS;
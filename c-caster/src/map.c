@@ -1,44 +1,668 @@
 #include "map.h"
+#include "config.h"
 #include "defs.h"
+#include "entity.h"
 #include "graphics.h"
+#include "input.h"
+#include "mapfile.h"
+#include "player.h"
 
-#include <stdint.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-#define _edgeHorz (MAP_NUM_COLS * TILE_SIZE)
-#define _edgeVert (MAP_NUM_ROWS * TILE_SIZE)
-
-static const int map[MAP_NUM_ROWS][MAP_NUM_COLS] = {
-    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 ,1, 1, 1, 1, 1, 1, 1},
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1},
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0, 0, 0, 1},
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-    {1, 0, 0, 0, 2, 2, 0, 3, 0, 4, 0, 5, 0, 6, 0, 0, 0, 0, 0, 1},
-    {1, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-    {1, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 1},
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 5},
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
-    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 5, 5, 5, 5, 5, 5}
-};
+// Chunks kept around the player in every direction, and how far ahead of the movement a second
+// area of the same size is prefetched
+#define CHUNK_RADIUS 2
+#define PREFETCH_CHUNKS 2
+#define CHUNK_AREA ((2 * CHUNK_RADIUS + 1) * (2 * CHUNK_RADIUS + 1))
+#define MIN_CHUNK_SLOTS (2 * CHUNK_AREA)
+
+#define CHANGE_LOG_SIZE 256
+
+typedef enum {
+	CHUNK_UNLOADED,
+	CHUNK_QUEUED,
+	CHUNK_RESIDENT,
+	CHUNK_EDITED,	// in a heap block of its own
+} chunk_state_t;
+
+typedef struct chunk_slot_t {
+	int chunk;				// -1 when free
+	uint64_t lastUsedFrame;
+} chunk_slot_t;
+
+typedef struct chunk_request_t {
+	int chunk;
+	int slot;
+} chunk_request_t;
+
+typedef struct door_t {
+	int row;
+	int col;
+	uint8_t tile;			// drawn while closed
+	bool open;
+	bool closing;			// asked to close, waits until nothing stands in it
+} door_t;
+
+typedef struct map_change_t {
+	uint64_t version;
+	map_region_t region;
+} map_change_t;
+
+typedef struct map_t {
+	int numCols;
+	int numRows;
+	float width;	// in pixels
+	float height;
+	int numChunkCols;
+	int numChunkRows;
+	mapped_file_t file;
+	const map_chunk_t *fileChunks;	// in the mapping, only the streaming thread reads them
+	map_chunk_t **chunks;			// the resident copy of every chunk, NULL when not resident
+	uint8_t *chunkStates;
+	map_chunk_t *slotChunks;		// numSlots chunks, the whole memory budget
+	chunk_slot_t *slots;
+	int numSlots;
+	int *freeSlots;
+	int numFreeSlots;
+	map_sprite_t *sprites;
+	int numSprites;
+	door_t *doors;
+	int numDoors;
+	int numClosingDoors;
+	const uint8_t *pvs;				// in the mapping
+	uint32_t pvsSize;
+} map_t;
+
+static map_t map;
+
+static uint64_t chunkFrame = 0;
+static int numLoads = 0;
+static int numEvictions = 0;
+static float lastX;
+static float lastY;
+static float headingX = 0;
+static float headingY = 0;
+
+// Version n is the n-th change, the log holds the most recent ones
+static uint64_t mapVersion = 0;
+static uint64_t loadVersion = 0;
+static map_change_t changeLog[CHANGE_LOG_SIZE];
+
+// The streaming thread copies the requests from loadedCount up to submitted out of the mapping,
+// the render thread takes in the results from collected up to loadedCount
+#define CHUNK_QUEUE_SIZE 64
+static chunk_request_t chunkQueue[CHUNK_QUEUE_SIZE];
+static uint64_t submitted = 0;
+static uint64_t loadedCount = 0;
+static uint64_t collected = 0;
+static pthread_t streamThread;
+static bool streaming = false;
+static bool stopStreaming = false;
+static pthread_mutex_t streamLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t streamReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t chunkLoaded = PTHREAD_COND_INITIALIZER;
+
+static bool isValidMap(const mapped_file_t *file, const char *fileName) {
+	const map_header_t *header = file->data;
+	if (file->size < sizeof(map_header_t) || memcmp(header->magic, MAP_FILE_MAGIC, 4) != 0) {
+		fprintf(stderr, "Not a map file=%s\n", fileName);
+		return false;
+	}
+	if (header->version != MAP_FILE_VERSION || header->byteOrder != MAP_FILE_BYTE_ORDER || header->chunkSize != MAP_CHUNK_SIZE) {
+		fprintf(stderr, "Map file=%s was written by another version or byte order, rebuild it\n", fileName);
+		return false;
+	}
+	if (header->numCols == 0 || header->numRows == 0 || (uint64_t)header->numCols * TILE_SIZE > INT32_MAX || (uint64_t)header->numRows * TILE_SIZE > INT32_MAX) {
+		fprintf(stderr, "Map file=%s has an invalid size of %ux%u\n", fileName, header->numCols, header->numRows);
+		return false;
+	}
+	const uint64_t numChunks = (uint64_t)getMapNumChunks(header->numCols) * getMapNumChunks(header->numRows);
+	const uint64_t size = sizeof(map_header_t) + numChunks * sizeof(map_chunk_t) + (uint64_t)header->numSprites * sizeof(map_sprite_t) + (uint64_t)header->numDoors * sizeof(map_door_t) + header->pvsSize;
+	if (size > file->size) {
+		fprintf(stderr, "Truncated map file=%s\n", fileName);
+		return false;
+	}
+	return true;
+}
+
+// NULL when the chunk holding the tile is not resident, row and col must be inside the map
+static inline const map_chunk_t *getChunkAt(int row, int col) {
+	return map.chunks[(row >> MAP_CHUNK_SHIFT) * map.numChunkCols + (col >> MAP_CHUNK_SHIFT)];
+}
+
+static inline int getChunkTileIndex(int row, int col) {
+	return (row & (MAP_CHUNK_SIZE - 1)) * MAP_CHUNK_SIZE + (col & (MAP_CHUNK_SIZE - 1));
+}
+
+// The tile as stored in the file, before any edit
+static uint8_t getFileTile(const map_t *data, int row, int col) {
+	const map_chunk_t *chunk = &data->fileChunks[(row >> MAP_CHUNK_SHIFT) * data->numChunkCols + (col >> MAP_CHUNK_SHIFT)];
+	return chunk->tiles[getChunkTileIndex(row, col)];
+}
+
+// Copied out of the mapping, the records after the chunks may not be aligned in the file
+static bool loadDoors(map_t *data, const uint8_t *fileDoors, const char *fileName) {
+	for (int i = 0; i < data->numDoors; i++) {
+		map_door_t record;
+		memcpy(&record, fileDoors + i * sizeof(record), sizeof(record));
+		if (record.col >= (uint32_t)data->numCols || record.row >= (uint32_t)data->numRows) {
+			fprintf(stderr, "Map file=%s has a door outside the map at %u, %u\n", fileName, record.col, record.row);
+			return false;
+		}
+		door_t *door = &data->doors[i];
+		door->row = record.row;
+		door->col = record.col;
+		door->tile = getFileTile(data, door->row, door->col);
+		door->open = door->tile == 0;
+		door->closing = false;
+	}
+	return true;
+}
+
+static void *streamMain(void *arg) {
+	(void)arg;
+	pthread_mutex_lock(&streamLock);
+	for (;;) {
+		while (!stopStreaming && loadedCount == submitted) {
+			pthread_cond_wait(&streamReady, &streamLock);
+		}
+		if (stopStreaming) {
+			break;
+		}
+		const chunk_request_t request = chunkQueue[loadedCount % CHUNK_QUEUE_SIZE];
+		pthread_mutex_unlock(&streamLock);
+
+		// Any page fault reading the file happens here instead of in the middle of a frame
+		memcpy(&map.slotChunks[request.slot], &map.fileChunks[request.chunk], sizeof(map_chunk_t));
+
+		pthread_mutex_lock(&streamLock);
+		loadedCount++;
+		pthread_cond_broadcast(&chunkLoaded);
+	}
+	pthread_mutex_unlock(&streamLock);
+	return NULL;
+}
+
+// Kept running from one map to the next, it only reads the map while a request is pending
+static bool startStreamingThread(void) {
+	if (streaming) {
+		return true;
+	}
+	if (pthread_create(&streamThread, NULL, streamMain, NULL) != 0) {
+		return false;
+	}
+	streaming = true;
+	return true;
+}
+
+static void waitForChunkLoads(void) {
+	pthread_mutex_lock(&streamLock);
+	while (loadedCount != submitted) {
+		pthread_cond_wait(&chunkLoaded, &streamLock);
+	}
+	pthread_mutex_unlock(&streamLock);
+}
+
+static void stopStreamingThread(void) {
+	if (!streaming) {
+		return;
+	}
+	pthread_mutex_lock(&streamLock);
+	stopStreaming = true;
+	pthread_cond_signal(&streamReady);
+	pthread_mutex_unlock(&streamLock);
+	pthread_join(streamThread, NULL);
+	submitted = loadedCount = collected = 0;
+	streaming = false;
+	stopStreaming = false;
+}
+
+static void makeResident(int chunk, int slot) {
+	map.chunks[chunk] = &map.slotChunks[slot];
+	map.chunkStates[chunk] = CHUNK_RESIDENT;
+	numLoads++;
+}
+
+static void collectLoadedChunks(void) {
+	pthread_mutex_lock(&streamLock);
+	const uint64_t end = loadedCount;
+	pthread_mutex_unlock(&streamLock);
+
+	for (uint64_t i = collected; i < end; i++) {
+		const chunk_request_t *request = &chunkQueue[i % CHUNK_QUEUE_SIZE];
+		if (map.chunkStates[request->chunk] == CHUNK_EDITED) {
+			// Edited while it was loading, the edit has its own copy
+			map.slots[request->slot].chunk = -1;
+			map.freeSlots[map.numFreeSlots++] = request->slot;
+		} else {
+			makeResident(request->chunk, request->slot);
+		}
+	}
+
+	// Only now can the requests be reused
+	pthread_mutex_lock(&streamLock);
+	collected = end;
+	pthread_mutex_unlock(&streamLock);
+}
+
+// A free slot, otherwise the slot of the resident chunk needed least recently that was not
+// needed this frame. -1 when every slot is in use this frame or still loading.
+static int allocateSlot(void) {
+	if (map.numFreeSlots > 0) {
+		return map.freeSlots[--map.numFreeSlots];
+	}
+	int oldest = -1;
+	for (int i = 0; i < map.numSlots; i++) {
+		const chunk_slot_t *slot = &map.slots[i];
+		if (map.chunkStates[slot->chunk] == CHUNK_RESIDENT && slot->lastUsedFrame < chunkFrame && (oldest < 0 || slot->lastUsedFrame < map.slots[oldest].lastUsedFrame)) {
+			oldest = i;
+		}
+	}
+	if (oldest >= 0) {
+		const int chunk = map.slots[oldest].chunk;
+		map.chunks[chunk] = NULL;
+		map.chunkStates[chunk] = CHUNK_UNLOADED;
+		numEvictions++;
+	}
+	return oldest;
+}
+
+// Marks the chunk as needed this frame and queues its load, or copies it right away when wait is
+// set. Returns false when no more chunks can be queued this frame.
+static bool requestChunk(int chunk, bool wait) {
+	if (map.chunkStates[chunk] == CHUNK_RESIDENT) {
+		map.slots[map.chunks[chunk] - map.slotChunks].lastUsedFrame = chunkFrame;
+		return true;
+	}
+	if (map.chunkStates[chunk] == CHUNK_QUEUED || map.chunkStates[chunk] == CHUNK_EDITED) {
+		return true;
+	}
+	// Only the render thread submits and collects, so the queue can't fill up behind its back
+	if (!wait && submitted - collected == CHUNK_QUEUE_SIZE) {
+		return false;
+	}
+	const int slot = allocateSlot();
+	if (slot < 0) {
+		return false;
+	}
+	map.slots[slot].chunk = chunk;
+	map.slots[slot].lastUsedFrame = chunkFrame;
+	if (wait) {
+		memcpy(&map.slotChunks[slot], &map.fileChunks[chunk], sizeof(map_chunk_t));
+		makeResident(chunk, slot);
+		return true;
+	}
+
+	map.chunkStates[chunk] = CHUNK_QUEUED;
+	pthread_mutex_lock(&streamLock);
+	chunkQueue[submitted % CHUNK_QUEUE_SIZE] = (chunk_request_t){chunk, slot};
+	submitted++;
+	pthread_cond_signal(&streamReady);
+	pthread_mutex_unlock(&streamLock);
+	return true;
+}
+
+// The chunks around the one at x, y, nearest first
+static void requestChunksAround(float x, float y, bool wait) {
+	const int centerCol = (int)floorf(x / (MAP_CHUNK_SIZE * TILE_SIZE));
+	const int centerRow = (int)floorf(y / (MAP_CHUNK_SIZE * TILE_SIZE));
+	for (int ring = 0; ring <= CHUNK_RADIUS; ring++) {
+		for (int row = centerRow - ring; row <= centerRow + ring; row++) {
+			if (row < 0 || row >= map.numChunkRows) {
+				continue;
+			}
+			// Every column on the top and bottom rows of the ring, the two sides in between
+			const int step = row == centerRow - ring || row == centerRow + ring ? 1 : 2 * ring;
+			for (int col = centerCol - ring; col <= centerCol + ring; col += step) {
+				if (col >= 0 && col < map.numChunkCols && !requestChunk(row * map.numChunkCols + col, wait)) {
+					return;
+				}
+			}
+		}
+	}
+}
+
+void updateMapChunks(float x, float y) {
+	if (map.chunks == NULL) {
+		return;
+	}
+	chunkFrame++;
+	collectLoadedChunks();
+
+	// Keeps heading the last way it moved while standing still
+	const float dx = x - lastX;
+	const float dy = y - lastY;
+	const float distance = sqrtf(dx * dx + dy * dy);
+	if (distance > 0) {
+		headingX = dx / distance;
+		headingY = dy / distance;
+	}
+	lastX = x;
+	lastY = y;
+
+	requestChunksAround(x, y, false);
+	const float ahead = PREFETCH_CHUNKS * MAP_CHUNK_SIZE * TILE_SIZE;
+	requestChunksAround(x + headingX * ahead, y + headingY * ahead, false);
+}
+
+void preloadMapChunks(float x, float y) {
+	if (map.chunks == NULL) {
+		return;
+	}
+	chunkFrame++;
+	waitForChunkLoads();
+	collectLoadedChunks();
+	requestChunksAround(x, y, true);
+	lastX = x;
+	lastY = y;
+}
+
+void preloadCameraChunks(const camera_t *cameras, int count) {
+	if (map.chunks == NULL) {
+		return;
+	}
+	chunkFrame++;
+	pthread_mutex_lock(&streamLock);
+	while (loadedCount != submitted) {
+		pthread_cond_wait(&chunkLoaded, &streamLock);
+	}
+	pthread_mutex_unlock(&streamLock);
+	collectLoadedChunks();
+	// All in one frame, so no camera evicts the chunks of the player or an earlier camera
+	requestChunksAround(player.x, player.y, true);
+	for (int i = 0; i < count; i++) {
+		requestChunksAround(cameras[i].x, cameras[i].y, true);
+	}
+}
+
+void getMapChunkStats(map_chunk_stats_t *stats) {
+	memset(stats, 0, sizeof(*stats));
+	stats->numChunks = map.numChunkCols * map.numChunkRows;
+	for (int i = 0; i < map.numSlots; i++) {
+		stats->numResident += map.slots[i].chunk >= 0 && map.chunkStates[map.slots[i].chunk] == CHUNK_RESIDENT;
+	}
+	for (int i = 0; i < stats->numChunks; i++) {
+		stats->numEdited += map.chunkStates[i] == CHUNK_EDITED;
+	}
+	stats->numSlots = map.numSlots;
+	stats->numLoads = numLoads;
+	stats->numEvictions = numEvictions;
+}
+
+static void freeMapData(map_t *data) {
+	for (int i = 0; data->chunkStates != NULL && i < data->numChunkCols * data->numChunkRows; i++) {
+		if (data->chunkStates[i] == CHUNK_EDITED) {
+			free(data->chunks[i]);
+		}
+	}
+	free(data->doors);
+	free(data->chunks);
+	free(data->chunkStates);
+	free(data->slotChunks);
+	free(data->slots);
+	free(data->freeSlots);
+	free(data->sprites);
+	if (data->file.data != NULL) {
+		unmapFile(&data->file);
+	}
+	memset(data, 0, sizeof(*data));
+}
+
+bool loadMap(const char *fileName, bool keepPlayer) {
+	map_t loaded;
+	memset(&loaded, 0, sizeof(loaded));
+	if (!mapFile(fileName, &loaded.file)) {
+		fprintf(stderr, "Could not load map=%s\n", fileName);
+		return false;
+	}
+	if (!isValidMap(&loaded.file, fileName)) {
+		freeMapData(&loaded);
+		return false;
+	}
+
+	const map_header_t *header = loaded.file.data;
+	loaded.numCols = header->numCols;
+	loaded.numRows = header->numRows;
+	loaded.width = (float)header->numCols * TILE_SIZE;
+	loaded.height = (float)header->numRows * TILE_SIZE;
+	loaded.numChunkCols = getMapNumChunks(header->numCols);
+	loaded.numChunkRows = getMapNumChunks(header->numRows);
+	loaded.fileChunks = (const map_chunk_t *)(header + 1);
+	loaded.numSprites = header->numSprites;
+	loaded.numDoors = header->numDoors;
+
+	// The budget, but always the two areas around the player and no more than the whole map
+	const int numChunks = loaded.numChunkCols * loaded.numChunkRows;
+	const size_t budgetSlots = ((size_t)config.mapBudgetMb << 20) / sizeof(map_chunk_t);
+	loaded.numSlots = budgetSlots > MIN_CHUNK_SLOTS ? (budgetSlots < (size_t)numChunks ? (int)budgetSlots : numChunks) : MIN_CHUNK_SLOTS;
+	loaded.numSlots = loaded.numSlots < numChunks ? loaded.numSlots : numChunks;
+
+	loaded.chunks = calloc(numChunks, sizeof(*loaded.chunks));
+	loaded.chunkStates = calloc(numChunks, 1);
+	loaded.slotChunks = malloc(loaded.numSlots * sizeof(map_chunk_t));
+	loaded.slots = malloc(loaded.numSlots * sizeof(chunk_slot_t));
+	loaded.freeSlots = malloc(loaded.numSlots * sizeof(int));
+	loaded.sprites = malloc(header->numSprites > 0 ? header->numSprites * sizeof(map_sprite_t) : 1);
+	loaded.doors = malloc(header->numDoors > 0 ? header->numDoors * sizeof(door_t) : 1);
+	if (loaded.chunks == NULL || loaded.chunkStates == NULL || loaded.slotChunks == NULL || loaded.slots == NULL || loaded.freeSlots == NULL || loaded.sprites == NULL || loaded.doors == NULL) {
+		fprintf(stderr, "Out of memory loading map=%s\n", fileName);
+		freeMapData(&loaded);
+		return false;
+	}
+	for (int i = 0; i < loaded.numSlots; i++) {
+		loaded.slots[i].chunk = -1;
+		loaded.freeSlots[i] = loaded.numSlots - 1 - i;
+	}
+	loaded.numFreeSlots = loaded.numSlots;
+
+	// Copied out of the mapping, the sprites may not be aligned in the file
+	memcpy(loaded.sprites, loaded.fileChunks + numChunks, header->numSprites * sizeof(map_sprite_t));
+	const uint8_t *fileDoors = (const uint8_t *)(loaded.fileChunks + numChunks) + header->numSprites * sizeof(map_sprite_t);
+	if (!loadDoors(&loaded, fileDoors, fileName)) {
+		freeMapData(&loaded);
+		return false;
+	}
+	loaded.pvsSize = header->pvsSize;
+	loaded.pvs = header->pvsSize > 0 ? fileDoors + header->numDoors * sizeof(map_door_t) : NULL;
+	if (!startStreamingThread()) {
+		fprintf(stderr, "Could not start streaming map=%s\n", fileName);
+		freeMapData(&loaded);
+		return false;
+	}
+
+	// Nothing can fail from here on, so this is the first point the current map is touched. The
+	// loads still queued are for its slots, they are waited for and dropped.
+	waitForChunkLoads();
+	pthread_mutex_lock(&streamLock);
+	submitted = loadedCount = collected = 0;
+	pthread_mutex_unlock(&streamLock);
+	freeMapData(&map);
+	map = loaded;
+	headingX = headingY = 0;
+	if (!keepPlayer) {
+		player.x = header->spawnX;
+		player.y = header->spawnY;
+		player.rotationAngle = header->spawnAngle;
+	}
+	loadVersion = ++mapVersion;
+	resetUseEdge();
+	preloadMapChunks(player.x, player.y);
+	printf("Map=%s loaded, %dx%d tiles in %d chunks, %d sprites and %d doors\n", fileName, map.numCols, map.numRows, numChunks, map.numSprites, map.numDoors);
+	return true;
+}
+
+void freeMap(void) {
+	stopStreamingThread();
+	freeMapData(&map);
+	headingX = headingY = 0;
+}
+
+// Gives the chunk a copy of its own that edits can change, out of the slots so it is never
+// evicted. A chunk that is not resident is read from the file right away.
+static map_chunk_t *editChunk(int chunk) {
+	if (map.chunkStates[chunk] == CHUNK_EDITED) {
+		return map.chunks[chunk];
+	}
+	map_chunk_t *edited = malloc(sizeof(map_chunk_t));
+	if (edited == NULL) {
+		return NULL;
+	}
+	if (map.chunkStates[chunk] == CHUNK_RESIDENT) {
+		const int slot = map.chunks[chunk] - map.slotChunks;
+		memcpy(edited, map.chunks[chunk], sizeof(map_chunk_t));
+		map.slots[slot].chunk = -1;
+		map.freeSlots[map.numFreeSlots++] = slot;
+	} else {
+		// A queued load still lands in its slot, which is freed when it is collected
+		memcpy(edited, &map.fileChunks[chunk], sizeof(map_chunk_t));
+	}
+	map.chunks[chunk] = edited;
+	map.chunkStates[chunk] = CHUNK_EDITED;
+	return edited;
+}
+
+static void markMapChanged(int minRow, int minCol, int maxRow, int maxCol) {
+	mapVersion++;
+	map_change_t *change = &changeLog[mapVersion % CHANGE_LOG_SIZE];
+	change->version = mapVersion;
+	change->region = (map_region_t){minRow, minCol, maxRow, maxCol};
+}
+
+bool setMapTile(int row, int col, int tile, bool solid) {
+	if (row < 0 || row >= map.numRows || col < 0 || col >= map.numCols || tile < 0 || tile > UINT8_MAX) {
+		return false;
+	}
+	const int index = getChunkTileIndex(row, col);
+	const map_chunk_t *current = getChunkAt(row, col);
+	if (current != NULL && current->tiles[index] == tile && ((current->solidity[index >> 3] >> (index & 7)) & 1) == solid) {
+		return true;
+	}
+	map_chunk_t *chunk = editChunk((row >> MAP_CHUNK_SHIFT) * map.numChunkCols + (col >> MAP_CHUNK_SHIFT));
+	if (chunk == NULL) {
+		fprintf(stderr, "Out of memory editing the map at %d, %d\n", col, row);
+		return false;
+	}
+	chunk->tiles[index] = tile;
+	if (solid) {
+		chunk->solidity[index >> 3] |= 1 << (index & 7);
+	} else {
+		chunk->solidity[index >> 3] &= ~(1 << (index & 7));
+	}
+	markMapChanged(row, col, row, col);
+	return true;
+}
+
+uint64_t getMapVersion(void) {
+	return mapVersion;
+}
+
+bool nextMapChange(uint64_t *version, map_region_t *region) {
+	if (*version >= mapVersion) {
+		return false;
+	}
+	if (*version < loadVersion || mapVersion - *version > CHANGE_LOG_SIZE) {
+		*region = (map_region_t){0, 0, map.numRows - 1, map.numCols - 1};
+		*version = mapVersion;
+		return true;
+	}
+	(*version)++;
+	*region = changeLog[*version % CHANGE_LOG_SIZE].region;
+	return true;
+}
+
+bool toggleDoor(int row, int col) {
+	for (int i = 0; i < map.numDoors; i++) {
+		door_t *door = &map.doors[i];
+		if (door->row != row || door->col != col) {
+			continue;
+		}
+		if (!door->open) {
+			door->open = true;
+			setMapTile(door->row, door->col, 0, false);
+		} else {
+			door->closing = !door->closing;
+			map.numClosingDoors += door->closing ? 1 : -1;
+		}
+		return true;
+	}
+	return false;
+}
+
+// The player and the guards collide at their centers, so a door only has to wait for the ones
+// centered in its tile
+static bool isTileOccupied(int row, int col) {
+	if ((int)floorf(player.x / TILE_SIZE) == col && (int)floorf(player.y / TILE_SIZE) == row) {
+		return true;
+	}
+	for (int i = 0; i < entities.count; i++) {
+		if ((int)floorf(entities.x[i] / TILE_SIZE) == col && (int)floorf(entities.y[i] / TILE_SIZE) == row) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void updateDoors(void) {
+	for (int i = 0; i < map.numDoors && map.numClosingDoors > 0; i++) {
+		door_t *door = &map.doors[i];
+		if (!door->closing || isTileOccupied(door->row, door->col)) {
+			continue;
+		}
+		door->open = false;
+		door->closing = false;
+		map.numClosingDoors--;
+		setMapTile(door->row, door->col, door->tile, true);
+	}
+}
+
+int getMapNumCols(void) {
+	return map.numCols;
+}
+
+int getMapNumRows(void) {
+	return map.numRows;
+}
+
+const map_sprite_t *getMapSprites(int *count) {
+	*count = map.numSprites;
+	return map.sprites;
+}
+
+const uint8_t *getMapPvs(uint32_t *size) {
+	*size = map.pvsSize;
+	return map.pvs;
+}
 
 bool mapHasWallAt(float x, float y) {
-	if (x < 0 || x >= (MAP_NUM_COLS * TILE_SIZE) || y < 0 || y > (MAP_NUM_ROWS * TILE_SIZE)) {
+	if (x < 0 || x >= map.width || y < 0 || y >= map.height) {
+		return true;
+	}
+	// Both are positive, so truncating is flooring
+	const int row = (int)(y / TILE_SIZE);
+	const int col = (int)(x / TILE_SIZE);
+	const map_chunk_t *chunk = getChunkAt(row, col);
+	if (chunk == NULL) {
 		return true;
 	}
-	const uint8_t mapGridIndexX = floor(x / TILE_SIZE);
-	const uint8_t mapGridIndexY = floor(y / TILE_SIZE);
-	return map[mapGridIndexY][mapGridIndexX] != 0;
+	const int tile = getChunkTileIndex(row, col);
+	return (chunk->solidity[tile >> 3] >> (tile & 7)) & 1;
 }
 
 void renderMapGrid(void) {
-	for (int i = 0; i < MAP_NUM_ROWS; i++) {
-		for (int j = 0; j < MAP_NUM_COLS; j++) {
+	// Only the tiles that land inside the color buffer, the ones not resident in gray
+	const int tileSize = MINIMAP_SCALE_FACTOR * TILE_SIZE;
+	const int numRows = map.numRows < config.renderHeight / tileSize + 1 ? map.numRows : config.renderHeight / tileSize + 1;
+	const int numCols = map.numCols < config.renderWidth / tileSize + 1 ? map.numCols : config.renderWidth / tileSize + 1;
+	for (int i = 0; i < numRows; i++) {
+		for (int j = 0; j < numCols; j++) {
 			int tileX = j * TILE_SIZE;
 			int tileY = i * TILE_SIZE;
-			color_t tileColor = map[i][j] | 0 ? 0xFFFFFFFF : 0;
+			const map_chunk_t *chunk = getChunkAt(i, j);
+			color_t tileColor = chunk == NULL ? 0xFF808080 : chunk->tiles[getChunkTileIndex(i, j)] != 0 ? 0xFFFFFFFF : 0;
 			drawRect(
 				MINIMAP_SCALE_FACTOR * tileX,
 				MINIMAP_SCALE_FACTOR * tileY,
@@ -50,10 +674,14 @@ void renderMapGrid(void) {
 	}
 }
 
-int getMapAt(int x, int y) {
-	return map[x][y];
+int getMapAt(int row, int col) {
+	if (row < 0 || row >= map.numRows || col < 0 || col >= map.numCols) {
+		return 0;
+	}
+	const map_chunk_t *chunk = getChunkAt(row, col);
+	return chunk != NULL ? chunk->tiles[getChunkTileIndex(row, col)] : 0;
 }
 
 bool isInsideMap(float x, float y) {
-	return x >= 0 & x <= _edgeHorz & y >= 0 & y <= _edgeVert;
-}
\ No newline at end of file
+	return x >= 0 & x <= map.width & y >= 0 & y <= map.height;
+}
@@ -2,13 +2,130 @@
 #define MAP_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "camera.h"
 
-#define MAP_NUM_ROWS 13
-#define MAP_NUM_COLS 20
+// Map file: a map_header_t, then the map in chunks of MAP_CHUNK_SIZE x MAP_CHUNK_SIZE tiles,
+// numChunkCols * numChunkRows map_chunk_t in rows, numSprites map_sprite_t, numDoors
+// map_door_t and pvsSize bytes of potentially visible set. Written by raycast-mapc in the byte
+// order of the machine that wrote it.
+#define MAP_FILE_MAGIC "RCMP"
+#define MAP_FILE_VERSION 4
+#define MAP_FILE_BYTE_ORDER 0x01020304
 
+#define MAP_CHUNK_SHIFT 6
+#define MAP_CHUNK_SIZE (1 << MAP_CHUNK_SHIFT)
+#define MAP_CHUNK_TILES (MAP_CHUNK_SIZE * MAP_CHUNK_SIZE)
+
+typedef struct map_header_t {
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t numCols;
+	uint32_t numRows;
+	uint32_t numSprites;
+	float spawnX;
+	float spawnY;
+	float spawnAngle;	// radians
+	uint32_t chunkSize;	// MAP_CHUNK_SIZE
+	uint32_t numDoors;
+	uint32_t pvsSize;	// 0 when the map has no PVS
+} map_header_t;
+
+// Tiles in rows, 0 is empty, otherwise the wall texture handle plus one. The solidity bitmap has
+// bit row * MAP_CHUNK_SIZE + col set for every tile that blocks movement and rays. The tiles of
+// the chunks on the right and bottom edges that fall outside the map are empty.
+typedef struct map_chunk_t {
+	uint8_t tiles[MAP_CHUNK_TILES];
+	uint8_t solidity[MAP_CHUNK_TILES / 8];
+} map_chunk_t;
+
+typedef struct map_sprite_t {
+	float x;
+	float y;
+	uint32_t texture;	// texture handle
+} map_sprite_t;
+
+// A wall tile that opens when used, its tile is the texture while closed
+typedef struct map_door_t {
+	uint32_t col;
+	uint32_t row;
+} map_door_t;
+
+// Potentially visible set, only for maps of up to MAP_PVS_MAX_TILES tiles: a uint32_t per tile
+// in rows with the offset of its set after them, MAP_PVS_NO_SET for a tile that was a wall, then
+// the sets. A set has bit row * numCols + col for every tile that may be seen from some point of
+// the tile, with doors counted as open. It is run-length encoded: every 0 byte is followed by
+// a byte with the number of 0 bytes it stands for.
+#define MAP_PVS_MAX_TILES (128 * 128)
+#define MAP_PVS_NO_SET UINT32_MAX
+
+// Tiles from minRow, minCol to maxRow, maxCol inclusive
+typedef struct map_region_t {
+	int minRow;
+	int minCol;
+	int maxRow;
+	int maxCol;
+} map_region_t;
+
+static inline uint32_t getMapNumChunks(uint32_t numTiles) {
+	return (numTiles + MAP_CHUNK_SIZE - 1) >> MAP_CHUNK_SHIFT;
+}
+
+typedef struct map_chunk_stats_t {
+	int numChunks;			// in the map
+	int numResident;
+	int numEdited;			// copied out for edits, never evicted
+	int numSlots;			// chunks that fit in config.mapBudgetMb
+	int numLoads;
+	int numEvictions;
+} map_chunk_stats_t;
+
+// Replaces the current map, which stays in place if the file can't be loaded. Moves the player
+// to the spawn point unless keepPlayer is set. The file stays mapped and its chunks are loaded
+// around the player, see updateMapChunks; the ones around the player are loaded before returning.
+bool loadMap(const char *fileName, bool keepPlayer);
+void freeMap(void);
+
+// Once per frame before casting: takes in the chunks streamed since the last frame and queues
+// the ones around x, y and ahead of the movement since the last call, evicting the least
+// recently needed chunks when the budget is full. Never waits for a chunk.
+void updateMapChunks(float x, float y);
+// Loads the chunks around x, y on the calling thread, for the tools that jump between poses
+void preloadMapChunks(float x, float y);
+// Loads the chunks around the player and every camera on the calling thread, for rendering views
+// far from the player. Chunks past config.mapBudgetMb stay out and render as walls.
+void preloadCameraChunks(const camera_t *cameras, int count);
+void getMapChunkStats(map_chunk_stats_t *stats);
+
+// Edits for the simulation, between frames. An edited chunk keeps its own copy for the rest of
+// the map's life. Every change bumps the map version, loading a map changes all of it.
+bool setMapTile(int row, int col, int tile, bool solid);
+uint64_t getMapVersion(void);
+// For caches derived from the map: reports the next region changed after *version and moves
+// *version past it, false once up to date. Reports the whole map when the change log no longer
+// reaches back to *version.
+bool nextMapChange(uint64_t *version, map_region_t *region);
+
+// Opens a closed door right away, asks an open one to close or takes that back. False if there is
+// no door at row, col.
+bool toggleDoor(int row, int col);
+// Once per tick after the input: closes the doors asked to, each one waits while the player or a
+// guard stands in it so nobody is sealed in a solid tile
+void updateDoors(void);
+
+int getMapNumCols(void);
+int getMapNumRows(void);
+const map_sprite_t *getMapSprites(int *count);
+// The PVS section of the map file as described above, NULL when it has none
+const uint8_t *getMapPvs(uint32_t *size);
+
+// Tiles of chunks that are not resident read as solid walls of tile 0, which draws the
+// placeholder texture
 bool mapHasWallAt(float x, float y);
 void renderMapGrid(void);
-int getMapAt(int x, int y);
+// The tile at row, col, 0 outside the map or in a chunk that is not resident
+int getMapAt(int row, int col);
 bool isInsideMap(float x, float y);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,45 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "mapfile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool mapFile(const char *fileName, mapped_file_t *file) {
+	memset(file, 0, sizeof(*file));
+	const int fd = open(fileName, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	// An empty file can't be mapped, callers treat it like any other unreadable file
+	struct stat status;
+	int error = fstat(fd, &status) != 0 ? errno : status.st_size == 0 ? EINVAL : 0;
+	if (error != 0) {
+		close(fd);
+		errno = error;
+		return false;
+	}
+
+	void *data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	error = errno;
+	close(fd);
+	if (data == MAP_FAILED) {
+		errno = error;
+		return false;
+	}
+
+	file->data = data;
+	file->size = status.st_size;
+	return true;
+}
+
+void unmapFile(mapped_file_t *file) {
+	if (file->data != NULL) {
+		munmap(file->data, file->size);
+	}
+	memset(file, 0, sizeof(*file));
+}
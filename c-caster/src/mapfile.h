@@ -0,0 +1,18 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A whole file mapped read-only. Pages are only read when they are first touched and the mapping
+// outlives the descriptor, so nothing is copied into the heap.
+typedef struct mapped_file_t {
+	void *data;
+	size_t size;
+} mapped_file_t;
+
+// Returns false with errno set when the file can't be opened, is empty or can't be mapped
+bool mapFile(const char *fileName, mapped_file_t *file);
+void unmapFile(mapped_file_t *file);
+
+#endif
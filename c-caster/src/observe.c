@@ -0,0 +1,143 @@
+#include "observe.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "entity.h"
+#include "jobs.h"
+#include "map.h"
+#include "profiler.h"
+#include "ray.h"
+#include "sprite.h"
+#include "view.h"
+#include "wall.h"
+
+// Jobs per thread, each renders a run of cameras with scratch of its own, a few per thread so
+// a slow run does not hold up the whole batch
+#define OBSERVATION_JOBS_PER_THREAD 4
+
+typedef struct observation_batch_t {
+	const camera_t *cameras;
+	int count;
+	int numJobs;
+	int width;
+	int height;
+	float distProjPlane;
+	color_t *frames;
+	view_planes_t planes;
+	int spriteCapacity;
+	const texture_t **textures;
+	int numTextures;
+} observation_batch_t;
+
+// Grow only, numJobs of each
+static ray_t *scratchRays = NULL;
+static sprite_t *scratchSprites = NULL;
+static const texture_t **textures = NULL;
+static uint8_t *usedTextures = NULL;		// numJobs rows of numTextures flags, what each job drew
+static size_t raysCapacity = 0;
+static size_t spritesCapacity = 0;
+static size_t texturesCapacity = 0;
+static size_t usedCapacity = 0;
+
+static bool reserve(void **buffer, size_t *capacity, size_t count, size_t size) {
+	if (count <= *capacity) {
+		return true;
+	}
+	void *grown = realloc(*buffer, count * size);
+	if (grown == NULL) {
+		return false;
+	}
+	*buffer = grown;
+	*capacity = count;
+	return true;
+}
+
+static void renderObservationJob(void *data, int job) {
+	const uint64_t zoneStart = profileBegin();
+	const observation_batch_t *batch = data;
+	view_t view;
+	view.width = batch->width;
+	view.height = batch->height;
+	view.distProjPlane = batch->distProjPlane;
+	view.pitch = batch->width;
+	view.rays = scratchRays + (size_t)job * batch->width;
+	view.visibleSprites = scratchSprites + (size_t)job * batch->spriteCapacity;
+	view.visibleCapacity = batch->spriteCapacity;
+	view.textures = batch->textures;
+	view.numTextures = batch->numTextures;
+	view.usedTextures = usedTextures + (size_t)job * batch->numTextures;
+	view.markSprites = false;
+
+	const int first = (int)((int64_t)batch->count * job / batch->numJobs);
+	const int end = (int)((int64_t)batch->count * (job + 1) / batch->numJobs);
+	for (int i = first; i < end; i++) {
+		view.camera = batch->cameras[i];
+		const size_t offset = (size_t)i * batch->width * batch->height;
+		view.pixels = batch->frames + offset;
+		view.planes.depth = batch->planes.depth != NULL ? batch->planes.depth + offset : NULL;
+		view.planes.depth16 = batch->planes.depth16 != NULL ? batch->planes.depth16 + offset : NULL;
+		view.planes.tileIds = batch->planes.tileIds != NULL ? batch->planes.tileIds + offset : NULL;
+		view.planes.spriteIds = batch->planes.spriteIds != NULL ? batch->planes.spriteIds + offset : NULL;
+		castViewRays(&view);
+		renderViewWalls(&view);
+		renderViewSprites(&view);
+	}
+	profileEnd(PROFILE_OBSERVATION_JOB, zoneStart);
+}
+
+bool renderObservations(const camera_t *cameras, int count, int width, int height, color_t *frames, const view_planes_t *planes) {
+	if (count <= 0 || width <= 0 || height <= 0) {
+		return count == 0;
+	}
+
+	const int maxJobs = getJobThreadCount() * OBSERVATION_JOBS_PER_THREAD;
+	observation_batch_t batch = {
+		cameras, count, count < maxJobs ? count : maxJobs, width, height,
+		(width >> 1) / (float)tan(config.fov / 2), frames,
+		planes != NULL ? *planes : (view_planes_t){NULL, NULL, NULL, NULL},
+		getSpriteCount() + entities.count, NULL, getTextureCount() + 1
+	};
+	if (!reserve((void **)&scratchRays, &raysCapacity, (size_t)batch.numJobs * width, sizeof(ray_t))
+		|| !reserve((void **)&scratchSprites, &spritesCapacity, (size_t)batch.numJobs * (batch.spriteCapacity > 0 ? batch.spriteCapacity : 1), sizeof(sprite_t))
+		|| !reserve((void **)&textures, &texturesCapacity, batch.numTextures, sizeof(*textures))
+		|| !reserve((void **)&usedTextures, &usedCapacity, (size_t)batch.numJobs * batch.numTextures, sizeof(*usedTextures))) {
+		fprintf(stderr, "Out of memory rendering %d observations of %dx%d\n", count, width, height);
+		return false;
+	}
+
+	// The workers may not look textures up themselves, they get the ready ones up front. Looking
+	// them up would mark every texture used and queue the decode of the whole set, so only the
+	// ones the workers drew are looked up afterwards: kept in the cache, or decoded for the next
+	// batch when they were drawn as the placeholder.
+	for (int i = 0; i < batch.numTextures; i++) {
+		textures[i] = peekTexture(i - 1);
+	}
+	memset(usedTextures, 0, (size_t)batch.numJobs * batch.numTextures);
+	batch.textures = textures;
+	preloadCameraChunks(cameras, count);
+
+	parallelFor(batch.numJobs, renderObservationJob, &batch);
+	for (int i = 1; i < batch.numTextures; i++) {
+		for (int job = 0; job < batch.numJobs; job++) {
+			if (usedTextures[(size_t)job * batch.numTextures + i]) {
+				getTexture(i - 1);
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+void freeObservations(void) {
+	free(scratchRays);
+	free(scratchSprites);
+	free(textures);
+	free(usedTextures);
+	scratchRays = NULL;
+	scratchSprites = NULL;
+	textures = NULL;
+	usedTextures = NULL;
+	raysCapacity = spritesCapacity = texturesCapacity = usedCapacity = 0;
+}
@@ -0,0 +1,20 @@
+#ifndef OBSERVE_H
+#define OBSERVE_H
+
+#include <stdbool.h>
+#include "camera.h"
+#include "graphics.h"
+#include "view.h"
+
+// First-person observations for many cameras at once, e.g. to train agents: every camera gets a
+// width x height frame at config.fov, rendered on the job workers from the same map, textures
+// and entities as the game. Frame i goes to frames + i * width * height, in rows of width pixels.
+// Main thread, between ticks; the map chunks around every camera are loaded first, see
+// preloadCameraChunks. Textures that are not decoded yet show the placeholder and are queued for
+// later batches, so call preloadTextures first. Scratch is reused from call to call, it only
+// grows. Returns false when out of memory, with the frames untouched. The planes that are not
+// NULL are packed like the frames, frame i's start at i * width * height elements.
+bool renderObservations(const camera_t *cameras, int count, int width, int height, color_t *frames, const view_planes_t *planes);
+void freeObservations(void);
+
+#endif
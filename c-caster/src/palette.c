@@ -0,0 +1,169 @@
+#include "palette.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct color_count_t {
+	color_t color;
+	uint32_t count;
+	uint8_t index;
+} color_count_t;
+
+// A median cut box over a run of the distinct colors
+typedef struct color_box_t {
+	int start;
+	int end;
+	int channel;	// the channel with the widest range
+	int range;
+} color_box_t;
+
+static inline int getChannel(color_t color, int channel) {
+	return (color >> (channel * 8)) & 0xFF;
+}
+
+static int compareColors(const void *a, const void *b) {
+	const color_t x = ((const color_count_t *)a)->color;
+	const color_t y = ((const color_count_t *)b)->color;
+	return x < y ? -1 : x > y;
+}
+
+// One comparator per channel, qsort has no context to pass the channel in
+#define COMPARE_CHANNEL(channel) \
+	static int compareChannel##channel(const void *a, const void *b) { \
+		return getChannel(((const color_count_t *)a)->color, channel) - getChannel(((const color_count_t *)b)->color, channel); \
+	}
+COMPARE_CHANNEL(0)
+COMPARE_CHANNEL(1)
+COMPARE_CHANNEL(2)
+COMPARE_CHANNEL(3)
+
+static int (*const compareChannel[4])(const void *, const void *) = {compareChannel0, compareChannel1, compareChannel2, compareChannel3};
+
+static void measureBox(const color_count_t *colors, color_box_t *box) {
+	box->range = -1;
+	for (int channel = 0; channel < 4; channel++) {
+		int low = 255;
+		int high = 0;
+		for (int i = box->start; i < box->end; i++) {
+			const int value = getChannel(colors[i].color, channel);
+			low = value < low ? value : low;
+			high = value > high ? value : high;
+		}
+		if (high - low > box->range) {
+			box->range = high - low;
+			box->channel = channel;
+		}
+	}
+}
+
+// Splits the box with the widest range at its weighted median, false when every box is a single color
+static bool splitBox(color_count_t *colors, color_box_t *boxes, int *numBoxes) {
+	color_box_t *widest = NULL;
+	for (int i = 0; i < *numBoxes; i++) {
+		if (boxes[i].end - boxes[i].start > 1 && (widest == NULL || boxes[i].range > widest->range)) {
+			widest = &boxes[i];
+		}
+	}
+	if (widest == NULL) {
+		return false;
+	}
+
+	qsort(colors + widest->start, widest->end - widest->start, sizeof(color_count_t), compareChannel[widest->channel]);
+	uint64_t total = 0;
+	for (int i = widest->start; i < widest->end; i++) {
+		total += colors[i].count;
+	}
+	uint64_t below = colors[widest->start].count;
+	int median = widest->start + 1;
+	while (median < widest->end - 1 && below * 2 < total) {
+		below += colors[median++].count;
+	}
+
+	color_box_t *upper = &boxes[(*numBoxes)++];
+	upper->start = median;
+	upper->end = widest->end;
+	widest->end = median;
+	measureBox(colors, widest);
+	measureBox(colors, upper);
+	return true;
+}
+
+static color_t averageBox(const color_count_t *colors, const color_box_t *box) {
+	uint64_t sums[4] = {0, 0, 0, 0};
+	uint64_t total = 0;
+	for (int i = box->start; i < box->end; i++) {
+		for (int channel = 0; channel < 4; channel++) {
+			sums[channel] += (uint64_t)getChannel(colors[i].color, channel) * colors[i].count;
+		}
+		total += colors[i].count;
+	}
+	color_t color = 0;
+	for (int channel = 0; channel < 4; channel++) {
+		color |= (color_t)((sums[channel] + total / 2) / total) << (channel * 8);
+	}
+	return color;
+}
+
+int quantizeColors(const color_t *texels, int numTexels, color_t keyColor, color_t *palette, uint8_t *indices) {
+	color_count_t *colors = malloc((numTexels > 0 ? numTexels : 1) * sizeof(color_count_t));
+	if (colors == NULL) {
+		return 0;
+	}
+
+	// Distinct colors with how often they occur
+	for (int i = 0; i < numTexels; i++) {
+		colors[i].color = texels[i];
+		colors[i].count = 1;
+	}
+	qsort(colors, numTexels, sizeof(color_count_t), compareColors);
+	int numColors = 0;
+	for (int i = 0; i < numTexels; i++) {
+		if (numColors > 0 && colors[numColors - 1].color == colors[i].color) {
+			colors[numColors - 1].count++;
+		} else {
+			colors[numColors++] = colors[i];
+		}
+	}
+
+	color_box_t boxes[MAX_PALETTE_SIZE];
+	int numBoxes = 0;
+	if (numColors <= MAX_PALETTE_SIZE) {
+		for (int i = 0; i < numColors; i++) {
+			boxes[numBoxes++] = (color_box_t){.start = i, .end = i + 1};
+		}
+	} else {
+		// The key color goes last, in a box of its own
+		int cutEnd = numColors;
+		for (int i = 0; i < numColors; i++) {
+			if (colors[i].color == keyColor) {
+				const color_count_t key = colors[i];
+				colors[i] = colors[numColors - 1];
+				colors[numColors - 1] = key;
+				boxes[numBoxes++] = (color_box_t){.start = numColors - 1, .end = numColors};
+				cutEnd = numColors - 1;
+				break;
+			}
+		}
+		boxes[numBoxes] = (color_box_t){.start = 0, .end = cutEnd};
+		measureBox(colors, &boxes[numBoxes++]);
+		while (numBoxes < MAX_PALETTE_SIZE && splitBox(colors, boxes, &numBoxes)) {
+		}
+	}
+
+	for (int i = 0; i < numBoxes; i++) {
+		palette[i] = averageBox(colors, &boxes[i]);
+		for (int j = boxes[i].start; j < boxes[i].end; j++) {
+			colors[j].index = i;
+		}
+	}
+
+	// Every texel finds its distinct color again, and with it the box that color ended up in
+	qsort(colors, numColors, sizeof(color_count_t), compareColors);
+	for (int i = 0; i < numTexels; i++) {
+		const color_count_t key = {.color = texels[i]};
+		const color_count_t *found = bsearch(&key, colors, numColors, sizeof(color_count_t), compareColors);
+		indices[i] = found->index;
+	}
+
+	free(colors);
+	return numBoxes;
+}
@@ -0,0 +1,15 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+#include "graphics.h"
+
+#define MAX_PALETTE_SIZE 256
+
+// Reduces texels to at most MAX_PALETTE_SIZE colors, writing one palette index per texel.
+// Exact when there are few enough distinct colors, otherwise a median cut weighted by how
+// often each color occurs. keyColor, if present, always keeps an exact entry of its own so
+// transparency survives. Returns the palette size, 0 when out of memory.
+int quantizeColors(const color_t *texels, int numTexels, color_t keyColor, color_t *palette, uint8_t *indices);
+
+#endif
@@ -0,0 +1,122 @@
+#define _GNU_SOURCE
+
+#include "perfcounters.h"
+#include <stdio.h>
+#include <string.h>
+
+const char *perfCounterNames[NUM_PERF_COUNTERS] = {
+	"cycles",
+	"instructions",
+	"l1d_misses",
+	"llc_misses",
+	"branch_misses"
+};
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+typedef struct perf_counter_config_t {
+	uint32_t type;
+	uint64_t config;
+} perf_counter_config_t;
+
+static const perf_counter_config_t counterConfigs[NUM_PERF_COUNTERS] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+// All counters live in one group so a single read() returns a consistent snapshot
+static int groupFd = -1;
+static int counterFds[NUM_PERF_COUNTERS] = {-1, -1, -1, -1, -1};
+static int numOpenCounters = 0;
+static int groupSlot[NUM_PERF_COUNTERS];
+
+static int openCounter(const perf_counter_config_t *counterConfig, int leaderFd) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = counterConfig->type;
+	attr.config = counterConfig->config;
+	attr.disabled = leaderFd == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, leaderFd, 0);
+}
+
+bool openPerfCounters(void) {
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		const int fd = openCounter(&counterConfigs[i], groupFd);
+		if (fd == -1) {
+			fprintf(stderr, "Perf counter %s unavailable\n", perfCounterNames[i]);
+			continue;
+		}
+		if (groupFd == -1) {
+			groupFd = fd;
+		}
+		counterFds[i] = fd;
+		groupSlot[i] = numOpenCounters++;
+	}
+	if (groupFd == -1) {
+		return false;
+	}
+
+	ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+}
+
+void closePerfCounters(void) {
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		if (counterFds[i] != -1) {
+			close(counterFds[i]);
+			counterFds[i] = -1;
+		}
+	}
+	groupFd = -1;
+	numOpenCounters = 0;
+}
+
+bool isPerfCounterAvailable(perf_counter_t counter) {
+	return counterFds[counter] != -1;
+}
+
+void readPerfCounters(perf_sample_t *sample) {
+	// PERF_FORMAT_GROUP layout: number of counters followed by their values in opening order
+	uint64_t buffer[1 + NUM_PERF_COUNTERS];
+	memset(sample, 0, sizeof(*sample));
+	if (groupFd == -1 || read(groupFd, buffer, sizeof(buffer)) < (ssize_t)sizeof(uint64_t)) {
+		return;
+	}
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		if (counterFds[i] != -1 && groupSlot[i] < (int)buffer[0]) {
+			sample->values[i] = buffer[1 + groupSlot[i]];
+		}
+	}
+}
+
+#else
+
+bool openPerfCounters(void) {
+	return false;
+}
+
+void closePerfCounters(void) {}
+
+bool isPerfCounterAvailable(perf_counter_t counter) {
+	(void)counter;
+	return false;
+}
+
+void readPerfCounters(perf_sample_t *sample) {
+	memset(sample, 0, sizeof(*sample));
+}
+
+#endif
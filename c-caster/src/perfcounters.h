@@ -0,0 +1,32 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum perf_counter_t {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	NUM_PERF_COUNTERS
+} perf_counter_t;
+
+typedef struct perf_sample_t {
+	uint64_t values[NUM_PERF_COUNTERS];
+} perf_sample_t;
+
+extern const char *perfCounterNames[NUM_PERF_COUNTERS];
+
+// Opens the hardware counters for the calling thread (Linux only). Counters the kernel or the
+// CPU refuse are left out, returns false when none could be opened, e.g perf_event_paranoid
+// is too strict or we run in a VM without a PMU. Everything below is then a no-op.
+bool openPerfCounters(void);
+void closePerfCounters(void);
+bool isPerfCounterAvailable(perf_counter_t counter);
+
+// Reads all counters in one go, unavailable ones read as 0
+void readPerfCounters(perf_sample_t *sample);
+
+#endif
@@ -2,14 +2,15 @@
 
 #include <math.h>
 #include <stdint.h>
+#include "camera.h"
 #include "defs.h"
 #include "graphics.h"
 #include "map.h"
 #include "utils.h"
 
 player_t player = {
-		WINDOW_WIDTH >> 1,
-		WINDOW_HEIGHT >> 1,
+		DEFAULT_RENDER_WIDTH >> 1,
+		DEFAULT_RENDER_HEIGHT >> 1,
 		100,
 		DEG_TO_RAD(90),
 		PI / 2,
@@ -36,10 +37,17 @@ void movePlayer(float deltaTime) {
 	player.y = newPlayerY;
 }
 
+bool useDoorAhead(void) {
+	const float reach = TILE_SIZE;
+	const float x = player.x + cosf(player.rotationAngle) * reach;
+	const float y = player.y + sinf(player.rotationAngle) * reach;
+	return toggleDoor((int)floorf(y / TILE_SIZE), (int)floorf(x / TILE_SIZE));
+}
+
 void renderMapPlayer(void) {
 	drawRect(
-		MINIMAP_SCALE_FACTOR * player.x,
-		MINIMAP_SCALE_FACTOR * player.y,
+		MINIMAP_SCALE_FACTOR * camera.x,
+		MINIMAP_SCALE_FACTOR * camera.y,
 		player.width,
 		player.height,
         0xFFFFFFFF
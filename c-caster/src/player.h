@@ -1,6 +1,7 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef struct player_t {
@@ -18,6 +19,8 @@ typedef struct player_t {
 extern player_t player;
 
 void movePlayer(float deltaTime);
+// Toggles the door on the tile in front of the player, if there is one
+bool useDoorAhead(void);
 void renderMapPlayer(void);
 
 #endif
\ No newline at end of file
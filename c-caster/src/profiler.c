@@ -0,0 +1,221 @@
+#include "profiler.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "defs.h"
+#include "graphics.h"
+#include "timer.h"
+
+// Must be a power of two, at ~12 events per frame plus one per worker job this holds seconds of
+// frames even with busy workers
+#define PROFILER_RING_SIZE 16384
+#define PROFILER_RING_MASK (PROFILER_RING_SIZE - 1)
+
+#define OVERLAY_FRAMES 120
+#define OVERLAY_BAR_WIDTH 2
+#define OVERLAY_HEIGHT 160
+#define OVERLAY_PIXELS_PER_MS 4
+#define OVERLAY_MARGIN 10
+
+typedef struct profile_event_t {
+	uint64_t sequence; // index + 1 once the slot is fully written, 0 while a writer owns it
+	uint64_t start;
+	uint64_t end;
+	uint8_t zone;
+	uint32_t thread;
+} profile_event_t;
+
+static const char *zoneNames[NUM_PROFILE_ZONES] = {
+	"frame",
+	"processInput",
+	"movePlayer",
+	"castAllRays",
+	"clearColorBuffer",
+	"renderWallProjection",
+	"renderSpriteProjection",
+	"minimap",
+	"present",
+	"inputLatency",
+	"loadTexture",
+	"updateEntities",
+	"updateEntityBatch",
+	"renderObservationJob"
+};
+
+static const color_t zoneColors[NUM_PROFILE_ZONES] = {
+	0x00000000,
+	0xFFFF00FF,
+	0xFF00FFFF,
+	0xFF0000FF,
+	0xFF888888,
+	0xFF00FF00,
+	0xFFFF0000,
+	0xFFFFFF00,
+	0xFF0088FF,
+	0xFF00AAFF,
+	0xFF888800,
+	0xFF00AA00,
+	0xFF006600,
+	0xFF660066
+};
+
+static profile_event_t events[PROFILER_RING_SIZE];
+static uint64_t eventHead = 0;
+static uint32_t threadCount = 0;
+
+// Each thread gets an id for the trace and keeps its own per-frame zone totals
+static __thread uint32_t threadIndex = 0;
+static __thread uint64_t frameTotals[NUM_PROFILE_ZONES];
+
+static float overlayHistory[OVERLAY_FRAMES][NUM_PROFILE_ZONES];
+static int overlayFrame = 0;
+static bool overlayVisible = false;
+
+uint64_t profileBegin(void) {
+	return getTimestampNs();
+}
+
+static void pushEvent(profile_zone_t zone, uint64_t start, uint64_t end) {
+	if (threadIndex == 0) {
+		threadIndex = __atomic_add_fetch(&threadCount, 1, __ATOMIC_RELAXED);
+	}
+
+	const uint64_t index = __atomic_fetch_add(&eventHead, 1, __ATOMIC_RELAXED);
+	profile_event_t *event = &events[index & PROFILER_RING_MASK];
+	__atomic_store_n(&event->sequence, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	event->start = start;
+	event->end = end;
+	event->zone = zone;
+	event->thread = threadIndex;
+	__atomic_store_n(&event->sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+void profileEnd(profile_zone_t zone, uint64_t start) {
+	const uint64_t end = getTimestampNs();
+	frameTotals[zone] += end - start;
+	pushEvent(zone, start, end);
+}
+
+void profileInputLatency(uint64_t inputTime, uint64_t presentTime) {
+	const uint64_t latency = presentTime - inputTime;
+	if (latency > frameTotals[PROFILE_INPUT_LATENCY]) {
+		frameTotals[PROFILE_INPUT_LATENCY] = latency;
+	}
+	pushEvent(PROFILE_INPUT_LATENCY, inputTime, presentTime);
+}
+
+void profilerEndFrame(void) {
+	for (int zone = 0; zone < NUM_PROFILE_ZONES; zone++) {
+		overlayHistory[overlayFrame][zone] = frameTotals[zone] / 1e6f;
+		frameTotals[zone] = 0;
+	}
+	overlayFrame = (overlayFrame + 1) % OVERLAY_FRAMES;
+}
+
+float getLastFrameZoneMs(profile_zone_t zone) {
+	return overlayHistory[(overlayFrame + OVERLAY_FRAMES - 1) % OVERLAY_FRAMES][zone];
+}
+
+void toggleProfilerOverlay(void) {
+	overlayVisible = !overlayVisible;
+}
+
+void renderProfilerOverlay(void) {
+	if (!overlayVisible) {
+		return;
+	}
+
+	const int width = OVERLAY_FRAMES * OVERLAY_BAR_WIDTH;
+	const int left = config.renderWidth - OVERLAY_MARGIN - width;
+	const int bottom = config.renderHeight - OVERLAY_MARGIN;
+	const int top = bottom - OVERLAY_HEIGHT;
+	drawRect(left, top, width - 1, OVERLAY_HEIGHT - 1, 0xFF111111);
+
+	// Oldest frame on the left, each bar stacks the zones in enum order and frames that
+	// presented input get a marker at their input latency
+	for (int i = 0; i < OVERLAY_FRAMES; i++) {
+		const float *zones = overlayHistory[(overlayFrame + i) % OVERLAY_FRAMES];
+		const int x = left + i * OVERLAY_BAR_WIDTH;
+		int y = bottom;
+		for (int zone = PROFILE_FRAME + 1; zone < PROFILE_INPUT_LATENCY && y > top; zone++) {
+			int height = zones[zone] * OVERLAY_PIXELS_PER_MS;
+			if (height > y - top) {
+				height = y - top;
+			}
+			if (height > 0) {
+				drawRect(x, y - height, OVERLAY_BAR_WIDTH - 1, height - 1, zoneColors[zone]);
+				y -= height;
+			}
+		}
+
+		const int latencyY = bottom - zones[PROFILE_INPUT_LATENCY] * OVERLAY_PIXELS_PER_MS;
+		if (zones[PROFILE_INPUT_LATENCY] > 0 && latencyY > top) {
+			drawRect(x, latencyY - 1, OVERLAY_BAR_WIDTH - 1, 1, zoneColors[PROFILE_INPUT_LATENCY]);
+		}
+	}
+
+	// Frame budget line
+	const int budgetY = bottom - FRAME_TIME_LENGTH * OVERLAY_PIXELS_PER_MS;
+	if (budgetY > top) {
+		drawLine(left, budgetY, left + width, budgetY, 0xFFFFFFFF);
+	}
+}
+
+bool exportProfilerTrace(const char *fileName) {
+	// Copied out first, the origin is the earliest start and a frame zone ends, and so lands in the
+	// ring, after the zones it encloses
+	profile_event_t *snapshot = malloc(PROFILER_RING_SIZE * sizeof(profile_event_t));
+	if (snapshot == NULL) {
+		fprintf(stderr, "Out of memory exporting trace=%s\n", fileName);
+		return false;
+	}
+	const uint64_t head = __atomic_load_n(&eventHead, __ATOMIC_ACQUIRE);
+	const uint64_t first = head > PROFILER_RING_SIZE ? head - PROFILER_RING_SIZE : 0;
+	int numEvents = 0;
+	uint64_t origin = UINT64_MAX;
+	for (uint64_t index = first; index < head; index++) {
+		const profile_event_t *slot = &events[index & PROFILER_RING_MASK];
+
+		// Copy the slot and skip it if a writer touched it while we were reading
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != index + 1) {
+			continue;
+		}
+		profile_event_t event;
+		memcpy(&event, slot, sizeof(event));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != index + 1) {
+			continue;
+		}
+		snapshot[numEvents++] = event;
+		if (event.start < origin) {
+			origin = event.start;
+		}
+	}
+
+	FILE *file = fopen(fileName, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Could not open trace=%s\n", fileName);
+		free(snapshot);
+		return false;
+	}
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	for (int i = 0; i < numEvents; i++) {
+		const profile_event_t *event = &snapshot[i];
+		fprintf(
+			file,
+			"%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+			i == 0 ? "" : ",\n",
+			zoneNames[event->zone],
+			event->thread,
+			(event->start - origin) / 1e3,
+			(event->end - event->start) / 1e3
+		);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	free(snapshot);
+	return true;
+}
@@ -0,0 +1,47 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum profile_zone_t {
+	PROFILE_FRAME,
+	PROFILE_PROCESS_INPUT,
+	PROFILE_MOVE_PLAYER,
+	PROFILE_CAST_ALL_RAYS,
+	PROFILE_CLEAR,
+	PROFILE_WALL_PROJECTION,
+	PROFILE_SPRITE_PROJECTION,
+	PROFILE_MINIMAP,
+	PROFILE_PRESENT,
+	// Zones from here on are not stacked in the overlay's frame bars
+	PROFILE_INPUT_LATENCY, // spans from an input event to the present showing it, see latency.h
+	PROFILE_LOAD_TEXTURE,
+	PROFILE_UPDATE_ENTITIES, // inside movePlayer, once per tick
+	PROFILE_ENTITY_BATCH, // one per batch of updateEntities, on the job workers
+	PROFILE_OBSERVATION_JOB, // one per job of renderObservations, on the job workers
+	NUM_PROFILE_ZONES
+} profile_zone_t;
+
+// Usage:
+//   uint64_t start = profileBegin();
+//   renderWallProjection();
+//   profileEnd(PROFILE_WALL_PROJECTION, start);
+// Safe to call from any thread, events go to a lock-free ring buffer holding the most recent captures.
+uint64_t profileBegin(void);
+void profileEnd(profile_zone_t zone, uint64_t start);
+// Records an input-to-photon span, the overlay marks the slowest one of each frame
+void profileInputLatency(uint64_t inputTime, uint64_t presentTime);
+
+// Closes the current frame on the main thread and moves its zone totals into the overlay history
+void profilerEndFrame(void);
+// Time spent in a zone on the main thread during the last closed frame
+float getLastFrameZoneMs(profile_zone_t zone);
+
+void toggleProfilerOverlay(void);
+void renderProfilerOverlay(void);
+
+// Writes the events currently held in the ring buffer as Chrome trace event JSON (chrome://tracing, Perfetto)
+bool exportProfilerTrace(const char *fileName);
+
+#endif
@@ -0,0 +1,136 @@
+#include "pvs.h"
+#include <stdio.h>
+#include <string.h>
+#include "defs.h"
+#include "map.h"
+
+// The sets of the last two tiles asked for, the camera and the player usually stand in different
+// ones
+#define PVS_CACHED_SETS 2
+
+static const uint8_t *pvs = NULL;		// the map's section, NULL while the PVS is off
+static uint32_t pvsSize;
+static int numCols;
+static int numRows;
+static int setBytes;
+static uint64_t checkedVersion = 0;
+static uint8_t sets[PVS_CACHED_SETS][MAP_PVS_MAX_TILES / 8];
+static int setTiles[PVS_CACHED_SETS];	// -1 when empty
+static int lastSet = 0;
+
+// The file may not align them
+static uint32_t getSetOffset(int tile) {
+	uint32_t offset;
+	memcpy(&offset, pvs + (size_t)tile * sizeof(offset), sizeof(offset));
+	return offset;
+}
+
+// The set stays off until the map is loaded again once an edit opens a tile that was a wall
+// when the PVS was compiled, the tiles seen through it are not in any set
+static bool isRegionCovered(const map_region_t *region) {
+	for (int row = region->minRow; row <= region->maxRow; row++) {
+		for (int col = region->minCol; col <= region->maxCol; col++) {
+			const float x = (col + 0.5f) * TILE_SIZE;
+			const float y = (row + 0.5f) * TILE_SIZE;
+			if (getSetOffset(row * numCols + col) == MAP_PVS_NO_SET && !mapHasWallAt(x, y)) {
+				fprintf(stderr, "The map was opened at %d, %d where the PVS has a wall, ignoring the PVS\n", col, row);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// A change of the whole map may be a new one, so the section is taken again before checking it
+static void updatePvs(void) {
+	map_region_t region;
+	while (nextMapChange(&checkedVersion, &region)) {
+		const bool wholeMap = region.minRow == 0 && region.minCol == 0 && region.maxRow == getMapNumRows() - 1 && region.maxCol == getMapNumCols() - 1;
+		if (wholeMap) {
+			numCols = getMapNumCols();
+			numRows = getMapNumRows();
+			setBytes = (numCols * numRows + 7) / 8;
+			pvs = getMapPvs(&pvsSize);
+			if (pvs != NULL && ((int64_t)numCols * numRows > MAP_PVS_MAX_TILES || pvsSize < (uint64_t)numCols * numRows * sizeof(uint32_t))) {
+				fprintf(stderr, "The map's PVS is invalid, ignoring it\n");
+				pvs = NULL;
+			}
+			for (int i = 0; i < PVS_CACHED_SETS; i++) {
+				setTiles[i] = -1;
+			}
+		}
+		if (pvs != NULL && !isRegionCovered(&region)) {
+			pvs = NULL;
+		}
+	}
+}
+
+// False when the set runs past the end of the section or decodes to the wrong size
+static bool decodeSet(uint32_t offset, uint8_t *set) {
+	const uint8_t *in = pvs + (size_t)numCols * numRows * sizeof(uint32_t);
+	const size_t size = pvsSize - (size_t)numCols * numRows * sizeof(uint32_t);
+	size_t i = offset;
+	int length = 0;
+	while (length < setBytes) {
+		if (i >= size) {
+			return false;
+		}
+		const uint8_t byte = in[i++];
+		if (byte != 0) {
+			set[length++] = byte;
+			continue;
+		}
+		if (i >= size || in[i] > setBytes - length) {
+			return false;
+		}
+		memset(set + length, 0, in[i]);
+		length += in[i++];
+	}
+	return true;
+}
+
+// The tile at x, y, -1 when the PVS is off or x, y is outside the map
+static int getPvsTile(float x, float y) {
+	if (pvs == NULL || x < 0 || y < 0 || x >= numCols * TILE_SIZE || y >= numRows * TILE_SIZE) {
+		return -1;
+	}
+	return (int)(y / TILE_SIZE) * numCols + (int)(x / TILE_SIZE);
+}
+
+const uint8_t *getVisibleTiles(float x, float y) {
+	updatePvs();
+	const int tile = getPvsTile(x, y);
+	if (tile < 0) {
+		return NULL;
+	}
+	for (int i = 0; i < PVS_CACHED_SETS; i++) {
+		if (setTiles[i] == tile) {
+			lastSet = i;
+			return sets[i];
+		}
+	}
+
+	const uint32_t offset = getSetOffset(tile);
+	if (offset == MAP_PVS_NO_SET) {
+		return NULL;
+	}
+
+	// Replaces the set not returned last, so the previous result is kept as long as possible
+	lastSet = (lastSet + 1) % PVS_CACHED_SETS;
+	if (!decodeSet(offset, sets[lastSet])) {
+		fprintf(stderr, "The map's PVS is invalid, ignoring it\n");
+		pvs = NULL;
+		setTiles[lastSet] = -1;
+		return NULL;
+	}
+	setTiles[lastSet] = tile;
+	return sets[lastSet];
+}
+
+bool isTileVisible(const uint8_t *visibleTiles, float x, float y) {
+	if (visibleTiles == NULL || x < 0 || y < 0 || x >= numCols * TILE_SIZE || y >= numRows * TILE_SIZE) {
+		return true;
+	}
+	const int tile = (int)(y / TILE_SIZE) * numCols + (int)(x / TILE_SIZE);
+	return (visibleTiles[tile >> 3] >> (tile & 7)) & 1;
+}
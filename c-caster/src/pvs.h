@@ -0,0 +1,19 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The potentially visible set compiled into the map (see map.h), as a hint for guards deciding
+// whether they may see the player. The set is sampled, not exact: raycast-mapc casts rays from a
+// few points of every tile and grows the result by a tile, so a tile seen only through a narrow
+// diagonal gap may be missing. That is why nothing is culled with it, sprites and guards are
+// drawn whether their tile is in the camera's set or not.
+// Returns the set of the tile at x, y, one bit per tile, or NULL when anything may be visible:
+// the map has no PVS, x, y is in a wall or an edit opened a wall the PVS counted on. Main thread
+// only, the set stays valid until the next call.
+const uint8_t *getVisibleTiles(float x, float y);
+// Always true for a NULL set and outside the map
+bool isTileVisible(const uint8_t *visibleTiles, float x, float y);
+
+#endif
@@ -1,16 +1,20 @@
 #include "ray.h"
+#include "config.h"
 #include "defs.h"
 #include "graphics.h"
-#include "player.h"
+#include "camera.h"
 #include <math.h>
 #include "map.h"
 #include "utils.h"
+#include "view.h"
 #include <float.h>
+#include <stdlib.h>
 
 static const float HALF_PI = 0.5 * PI;
 static const float ONE_POINT_FIVE_PI = 1.5 * PI; 
 
-ray_t rays[NUM_RAYS];
+ray_t *rays = NULL;
+static int raysCapacity = 0;
 
 static inline bool isRayFacingDown(float *angle) {
     return *angle > 0 & *angle < PI;
@@ -28,7 +32,7 @@ static inline bool isRayFacingLeft(float *angle) {
     return !isRayFacingRight(angle);
 }
 
-static void castRay(float rayAngle, int stripId) {
+static void castRay(const camera_t *camera, float rayAngle, ray_t *ray) {
 	normalizeAngle(&rayAngle);
     
     float xintercept, yintercept;
@@ -48,13 +52,13 @@ static void castRay(float rayAngle, int stripId) {
     float horzWallHitY = 0;
 
     // Find the y-coordinate of the closest horizontal grid intersection
-    yintercept = floorf(player.y / TILE_SIZE) * TILE_SIZE;
+    yintercept = floorf(camera->y / TILE_SIZE) * TILE_SIZE;
     if (isFacingDown) {
         yintercept += TILE_SIZE;
     }
 
     // Find the x-coordinate of the closest horizontal grid intersection
-    xintercept = player.x + (yintercept - player.y) / tanf(rayAngle);
+    xintercept = camera->x + (yintercept - camera->y) / tanf(rayAngle);
 
     // Calculate the increment xstep and ystep
     ystep = isFacingUp ? -TILE_SIZE : TILE_SIZE;
@@ -82,8 +86,8 @@ static void castRay(float rayAngle, int stripId) {
             horzWallHitX = nextHorzTouchX;
             horzWallHitY = nextHorzTouchY;
             horzWallContent = getMapAt(
-                (uint8_t)floorf(yToCheck / TILE_SIZE), 
-                (uint8_t)floorf(xToCheck / TILE_SIZE)
+                (int)floorf(yToCheck / TILE_SIZE),
+                (int)floorf(xToCheck / TILE_SIZE)
             );
             foundHorzWallHit = true;
             break;
@@ -102,11 +106,11 @@ static void castRay(float rayAngle, int stripId) {
     float vertWallHitY = 0;
 
     // Find the x-coordinate of the closest horizontal grid intersection
-    xintercept = floor(player.x / TILE_SIZE) * TILE_SIZE;
+    xintercept = floor(camera->x / TILE_SIZE) * TILE_SIZE;
     xintercept += isFacingRight ? TILE_SIZE : 0;
 
     // Find the y-coordinate of the closest horizontal grid intersection
-    yintercept = player.y + (xintercept - player.x) * tanf(rayAngle);
+    yintercept = camera->y + (xintercept - camera->x) * tanf(rayAngle);
 
     // Calculate the increment xstep and ystep
     xstep = TILE_SIZE;
@@ -128,7 +132,7 @@ static void castRay(float rayAngle, int stripId) {
             // found a wall hit
             vertWallHitX = nextVertTouchX;
             vertWallHitY = nextVertTouchY;
-            vertWallContent = getMapAt((uint8_t) floorf (yToCheck / TILE_SIZE), (uint8_t) floorf(xToCheck / TILE_SIZE));
+            vertWallContent = getMapAt((int)floorf(yToCheck / TILE_SIZE), (int)floorf(xToCheck / TILE_SIZE));
             foundVertWallHit = true;
             break;
         } else {
@@ -138,39 +142,66 @@ static void castRay(float rayAngle, int stripId) {
     }
 
     // Calculate both horizontal and vertical hit distances and choose the smallest one
-    float horzHitDistance = foundHorzWallHit ? distanceBetweenPoints(player.x, player.y, horzWallHitX, horzWallHitY) : FLT_MAX;
-    float vertHitDistance = foundVertWallHit ? distanceBetweenPoints(player.x, player.y, vertWallHitX, vertWallHitY) : FLT_MAX;
+    float horzHitDistance = foundHorzWallHit ? distanceBetweenPoints(camera->x, camera->y, horzWallHitX, horzWallHitY) : FLT_MAX;
+    float vertHitDistance = foundVertWallHit ? distanceBetweenPoints(camera->x, camera->y, vertWallHitX, vertWallHitY) : FLT_MAX;
 
     if (vertHitDistance < horzHitDistance) {
-        rays[stripId].distance = vertHitDistance;
-        rays[stripId].wallHitX = vertWallHitX;
-        rays[stripId].wallHitY = vertWallHitY;
-        rays[stripId].wallHitContent = vertWallContent;
-        rays[stripId].wasHitVertical = true;
+        ray->distance = vertHitDistance;
+        ray->wallHitX = vertWallHitX;
+        ray->wallHitY = vertWallHitY;
+        ray->wallHitContent = vertWallContent;
+        ray->wasHitVertical = true;
     } else {
-        rays[stripId].distance = horzHitDistance;
-        rays[stripId].wallHitX = horzWallHitX;
-        rays[stripId].wallHitY = horzWallHitY;
-        rays[stripId].wallHitContent = horzWallContent;
-        rays[stripId].wasHitVertical = false;
+        ray->distance = horzHitDistance;
+        ray->wallHitX = horzWallHitX;
+        ray->wallHitY = horzWallHitY;
+        ray->wallHitContent = horzWallContent;
+        ray->wasHitVertical = false;
     }
-    rays[stripId].rayAngle = rayAngle;
+    ray->rayAngle = rayAngle;
 }
 
-void castAllRays(void) {
+// Grows only, so switching between resolutions does not reallocate every time
+bool createRays(int count) {
+	if (count <= raysCapacity) {
+		return true;
+	}
+	ray_t *buffer = realloc(rays, count * sizeof(ray_t));
+	if (buffer == NULL) {
+		return false;
+	}
+	rays = buffer;
+	raysCapacity = count;
+	return true;
+}
+
+void freeRays(void) {
+	free(rays);
+	rays = NULL;
+	raysCapacity = 0;
+}
+
+void castViewRays(const view_t *view) {
 	// Start first ray subtracting half of our FOV
-	int halfnrays = NUM_RAYS >> 1;
-	for (int col = 0; col < NUM_RAYS; col++) {
-		float rayAngle = player.rotationAngle + atanf((col - halfnrays) / DIST_PROJ_PLANE);
-		castRay(rayAngle, col);
+	const int numRays = view->width;
+	int halfnrays = numRays >> 1;
+	for (int col = 0; col < numRays; col++) {
+		float rayAngle = view->camera.angle + atanf((col - halfnrays) / view->distProjPlane);
+		castRay(&view->camera, rayAngle, &view->rays[col]);
 	}
 }
 
+void castAllRays(void) {
+	view_t view;
+	getScreenView(&view);
+	castViewRays(&view);
+}
+
 void renderMapRays(void) {
-	for (int i = 0; i < NUM_RAYS; i += 50) {
+	for (int i = 0; i < config.renderWidth; i += 50) {
         drawLine(
-    		MINIMAP_SCALE_FACTOR * player.x, 
-	    	MINIMAP_SCALE_FACTOR * player.y, 
+    		MINIMAP_SCALE_FACTOR * camera.x, 
+	    	MINIMAP_SCALE_FACTOR * camera.y, 
 		    MINIMAP_SCALE_FACTOR * rays[i].wallHitX, 
 		    MINIMAP_SCALE_FACTOR * rays[i].wallHitY,
             0xFF0000FF
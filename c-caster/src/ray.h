@@ -5,8 +5,6 @@
 #include <stdbool.h>
 #include "defs.h"
 
-#define NUM_RAYS WINDOW_WIDTH
-
 typedef struct ray_t {
 	float rayAngle;
 	float wallHitX;
@@ -16,8 +14,16 @@ typedef struct ray_t {
 	uint8_t wallHitContent;		
 } ray_t;
 
-extern ray_t rays[NUM_RAYS];
+// One ray per column of the render resolution (config.renderWidth)
+extern ray_t *rays;
+
+struct view_t;
 
+bool createRays(int count);
+void freeRays(void);
+// Fills the view's rays, one per column
+void castViewRays(const struct view_t *view);
+// castViewRays for the screen view
 void castAllRays(void);
 void renderMapRays(void);
 
@@ -0,0 +1,213 @@
+#include "raycast.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "camera.h"
+#include "config.h"
+#include "defs.h"
+#include "entity.h"
+#include "input.h"
+#include "jobs.h"
+#include "map.h"
+#include "observe.h"
+#include "player.h"
+#include "ray.h"
+#include "sprite.h"
+#include "textures.h"
+#include "view.h"
+#include "wall.h"
+
+// Scratch for raycastRender and raycastRenderBatch, it only grows
+struct raycast_engine_t {
+	bool hasMap;
+	ray_t *rays;
+	int raysCapacity;
+	sprite_t *visibleSprites;
+	int spritesCapacity;
+	camera_t *cameras;
+	int camerasCapacity;
+};
+
+static raycast_engine_t *engineInstance = NULL;
+
+static int8_t clampDirection(int8_t direction) {
+	return direction < -1 ? -1 : direction > 1 ? 1 : direction;
+}
+
+static bool reserve(void **buffer, int *capacity, int count, size_t size) {
+	if (count <= *capacity) {
+		return true;
+	}
+	void *grown = realloc(*buffer, (size_t)count * size);
+	if (grown == NULL) {
+		return false;
+	}
+	*buffer = grown;
+	*capacity = count;
+	return true;
+}
+
+int raycastGetApiVersion(void) {
+	return RAYCAST_API_VERSION;
+}
+
+void raycastGetDefaultOptions(raycast_options_t *options) {
+	options->threads = 0;
+	options->fovDegrees = DEFAULT_FOV * (180 / PI);
+	options->textureBudgetMb = 0;
+	options->indexedTextures = false;
+	options->mapBudgetMb = DEFAULT_MAP_BUDGET_MB;
+	options->guards = 0;
+}
+
+raycast_engine_t *raycastCreate(const raycast_options_t *options) {
+	if (engineInstance != NULL) {
+		fprintf(stderr, "Only one engine can exist at a time\n");
+		return NULL;
+	}
+	raycast_engine_t *engine = calloc(1, sizeof(raycast_engine_t));
+	if (engine == NULL) {
+		fprintf(stderr, "Out of memory creating the engine\n");
+		return NULL;
+	}
+
+	// Kept to put back when the engine can't be created
+	const config_t previousConfig = config;
+	config.threads = options->threads;
+	config.textureBudgetMb = options->textureBudgetMb;
+	config.indexedTextures = options->indexedTextures;
+	config.mapBudgetMb = options->mapBudgetMb;
+	config.guards = options->guards;
+	setFov(DEG_TO_RAD(options->fovDegrees));
+
+	startJobWorkers(config.threads);
+	if (!loadTextures() || !preloadTextures()) {
+		freeTextures();
+		stopJobWorkers();
+		free(engine);
+		config = previousConfig;
+		return NULL;
+	}
+	engineInstance = engine;
+	return engine;
+}
+
+void raycastDestroy(raycast_engine_t *engine) {
+	if (engine == NULL || engine != engineInstance) {
+		return;
+	}
+	freeObservations();
+	freeEntities();
+	freeSprites();
+	freeMap();
+	freeTextures();
+	stopJobWorkers();
+	free(engine->rays);
+	free(engine->visibleSprites);
+	free(engine->cameras);
+	free(engine);
+	engineInstance = NULL;
+}
+
+bool raycastLoadMap(raycast_engine_t *engine, const char *fileName) {
+	if (!loadMap(fileName, false) || !createSprites()) {
+		return false;
+	}
+	freeEntities();
+	engine->hasMap = spawnGuards(config.guards, GUARD_SEED);
+	return engine->hasMap;
+}
+
+void raycastStep(raycast_engine_t *engine, const raycast_input_t *input) {
+	(void)engine;
+	// Anything past one step a tick would scale the player's speed
+	tick_input_t tickInput = {clampDirection(input->walkDirection), clampDirection(input->turnDirection), input->use != 0};
+	applyTickInput(tickInput);
+	// Nothing may render between steps, and a chunk that is not loaded reads as a wall
+	preloadCameraChunks(NULL, 0);
+	movePlayer(SIM_TICK_DELTA_TIME);
+	updateDoors();
+	updateEntities(SIM_TICK_DELTA_TIME);
+}
+
+void raycastGetPlayerPose(const raycast_engine_t *engine, raycast_pose_t *pose) {
+	(void)engine;
+	pose->x = player.x;
+	pose->y = player.y;
+	pose->angle = player.rotationAngle;
+}
+
+void raycastSetPlayerPose(raycast_engine_t *engine, const raycast_pose_t *pose) {
+	(void)engine;
+	player.x = pose->x;
+	player.y = pose->y;
+	player.rotationAngle = pose->angle;
+}
+
+int raycastGetMapSpriteCount(const raycast_engine_t *engine) {
+	(void)engine;
+	return getSpriteCount();
+}
+
+static view_planes_t getViewPlanes(const raycast_planes_t *planes) {
+	if (planes == NULL) {
+		return (view_planes_t){NULL, NULL, NULL, NULL};
+	}
+	return (view_planes_t){planes->depth, planes->depth16, planes->tileIds, planes->spriteIds};
+}
+
+bool raycastRender(raycast_engine_t *engine, const raycast_pose_t *pose, uint32_t *pixels, int width, int height, int pitch) {
+	return raycastRenderPlanes(engine, pose, pixels, width, height, pitch, NULL);
+}
+
+bool raycastRenderPlanes(raycast_engine_t *engine, const raycast_pose_t *pose, uint32_t *pixels, int width, int height, int pitch, const raycast_planes_t *planes) {
+	if (!engine->hasMap || width <= 0 || height <= 0 || pitch < width * (int)sizeof(color_t) || pitch % sizeof(color_t) != 0) {
+		return false;
+	}
+	const int numSprites = getSpriteCount() + entities.count;
+	if (!reserve((void **)&engine->rays, &engine->raysCapacity, width, sizeof(ray_t))
+		|| !reserve((void **)&engine->visibleSprites, &engine->spritesCapacity, numSprites > 0 ? numSprites : 1, sizeof(sprite_t))) {
+		fprintf(stderr, "Out of memory rendering %dx%d\n", width, height);
+		return false;
+	}
+
+	const camera_t camera = {pose->x, pose->y, pose->angle};
+	updateTextureCache();
+	preloadCameraChunks(&camera, 1);
+
+	view_t view;
+	view.camera = camera;
+	view.width = width;
+	view.height = height;
+	view.distProjPlane = (width >> 1) / (float)tan(config.fov / 2);
+	view.pixels = pixels;
+	view.pitch = pitch / sizeof(color_t);
+	view.rays = engine->rays;
+	view.visibleSprites = engine->visibleSprites;
+	view.visibleCapacity = engine->spritesCapacity;
+	view.textures = NULL;
+	view.numTextures = 0;
+	view.usedTextures = NULL;
+	view.markSprites = false;
+	view.planes = getViewPlanes(planes);
+	castViewRays(&view);
+	renderViewWalls(&view);
+	renderViewSprites(&view);
+	return true;
+}
+
+bool raycastRenderBatch(raycast_engine_t *engine, const raycast_pose_t *poses, int count, uint32_t *frames, int width, int height) {
+	return raycastRenderBatchPlanes(engine, poses, count, frames, width, height, NULL);
+}
+
+bool raycastRenderBatchPlanes(raycast_engine_t *engine, const raycast_pose_t *poses, int count, uint32_t *frames, int width, int height, const raycast_planes_t *planes) {
+	if (!engine->hasMap || count < 0 || !reserve((void **)&engine->cameras, &engine->camerasCapacity, count, sizeof(camera_t))) {
+		return false;
+	}
+	for (int i = 0; i < count; i++) {
+		engine->cameras[i] = (camera_t){poses[i].x, poses[i].y, poses[i].angle};
+	}
+	updateTextureCache();
+	const view_planes_t viewPlanes = getViewPlanes(planes);
+	return renderObservations(engine->cameras, count, width, height, frames, &viewPlanes);
+}
@@ -0,0 +1,84 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+// The engine as a library (libraycast.a / libraycast.so, see `make lib`), to embed it in another
+// process instead of running the game. Everything goes through an engine handle, frames are
+// rendered into memory the caller owns and the library does not depend on SDL.
+//
+// Only this header is the stable interface: its types only ever gain fields at the end and
+// RAYCAST_API_VERSION goes up when they do. The engine's state is process wide, so there is one
+// engine at a time, used from the thread that created it. Asset paths are relative to the
+// working directory, like the game's.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RAYCAST_API_VERSION 2
+
+typedef struct raycast_engine_t raycast_engine_t;
+
+typedef struct raycast_options_t {
+	int threads;			// job threads including the calling one, 0 uses one per CPU
+	float fovDegrees;		// horizontal field of view of every render
+	int textureBudgetMb;	// decoded textures kept on the heap, 0 keeps every texture
+	bool indexedTextures;	// quantize decoded textures to a palette, a byte per texel
+	int mapBudgetMb;		// map chunks kept in memory around the player
+	int guards;				// spawned around the player on every map load
+} raycast_options_t;
+
+typedef struct raycast_pose_t {
+	float x;				// in world units, 64 per tile
+	float y;
+	float angle;			// radians, 0 looks along +x and angles grow towards +y
+} raycast_pose_t;
+
+// What the player does for one simulation tick, directions are clamped to -1..1 and use to 0/1
+typedef struct raycast_input_t {
+	int8_t walkDirection;	// -1 back, +1 forward
+	int8_t turnDirection;	// -1 left, +1 right
+	int8_t use;				// 1 while the use key is held, opens doors on the rising edge
+} raycast_input_t;
+
+// Outputs rendered in the same pass as the color, without casting again; NULL leaves one out at no
+// per-pixel cost. One element per pixel, rows are as many elements apart as the color's are pixels.
+typedef struct raycast_planes_t {
+	float *depth;			// distance along the view direction in world units, floor and ceiling too
+	uint16_t *depth16;		// the same in whole world units, saturating at 65535
+	uint8_t *tileIds;		// map content of the wall seen, 0 on floor, ceiling and sprites
+	uint16_t *spriteIds;	// 0 for none, map sprite i is i + 1 and the guards follow in spawn order
+} raycast_planes_t;
+
+int raycastGetApiVersion(void);
+void raycastGetDefaultOptions(raycast_options_t *options);
+
+// NULL when an engine already exists or the textures can't be loaded, leaving the configuration
+// as it was. Decodes every texture
+// before returning, so renders never show placeholders for them.
+raycast_engine_t *raycastCreate(const raycast_options_t *options);
+void raycastDestroy(raycast_engine_t *engine);
+
+// Replaces the level with a compiled map file (see raycast-mapc) and moves the player to its
+// spawn point. The current level stays when the file can't be loaded.
+bool raycastLoadMap(raycast_engine_t *engine, const char *fileName);
+
+// Advances the simulation by one tick of 1/60 s: the player, doors and guards. The map chunks
+// around the player are loaded first, so stepping without rendering never runs into unloaded ones.
+void raycastStep(raycast_engine_t *engine, const raycast_input_t *input);
+void raycastGetPlayerPose(const raycast_engine_t *engine, raycast_pose_t *pose);
+void raycastSetPlayerPose(raycast_engine_t *engine, const raycast_pose_t *pose);
+// Sprites the map places, the first guard's sprite ID is one past it
+int raycastGetMapSpriteCount(const raycast_engine_t *engine);
+
+// Renders the view from pose into width x height RGBA32 pixels, each row pitch bytes after the
+// previous one. The map chunks around the pose, or every pose of a batch, are loaded first, so
+// any pose renders like the player standing there while they fit the map budget. False when the
+// size or pitch is invalid or out of memory.
+bool raycastRender(raycast_engine_t *engine, const raycast_pose_t *pose, uint32_t *pixels, int width, int height, int pitch);
+// Renders count poses in parallel into count frames of width x height packed one after the other
+bool raycastRenderBatch(raycast_engine_t *engine, const raycast_pose_t *poses, int count, uint32_t *frames, int width, int height);
+// The two above with the planes filled in as well, packed like the frames for a batch. Since
+// version 2.
+bool raycastRenderPlanes(raycast_engine_t *engine, const raycast_pose_t *pose, uint32_t *pixels, int width, int height, int pitch, const raycast_planes_t *planes);
+bool raycastRenderBatchPlanes(raycast_engine_t *engine, const raycast_pose_t *poses, int count, uint32_t *frames, int width, int height, const raycast_planes_t *planes);
+
+#endif
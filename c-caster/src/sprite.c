@@ -1,32 +1,85 @@
 #include "sprite.h"
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include "config.h"
 #include "defs.h"
 #include "graphics.h"
-#include "player.h"
+#include "camera.h"
+#include "entity.h"
+#include "map.h"
 #include "ray.h"
 #include "textures.h"
-#include "upng.h"
 #include "utils.h"
+#include "view.h"
+
+// Placed by the map, visibleSprites is scratch space for sorting the ones in view together with
+// the entities
+static sprite_t *sprites = NULL;
+static sprite_t *visibleSprites = NULL;
+static int numSprites = 0;
+static int visibleCapacity = 0;
+
+bool createSprites(void) {
+    int count;
+    const map_sprite_t *placements = getMapSprites(&count);
+    sprite_t *created = calloc(count > 0 ? count : 1, sizeof(sprite_t));
+    sprite_t *scratch = malloc((count > 0 ? count : 1) * sizeof(sprite_t));
+    if (created == NULL || scratch == NULL) {
+        fprintf(stderr, "Out of memory creating %d sprites\n", count);
+        free(created);
+        free(scratch);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        created[i].x = placements[i].x;
+        created[i].y = placements[i].y;
+        created[i].texture = placements[i].texture;
+        created[i].id = getViewSpriteId(i);
+    }
 
-#define NUM_SPRITES 3
-#define TEXTURE_BARREL 9
+    freeSprites();
+    sprites = created;
+    visibleSprites = scratch;
+    numSprites = count;
+    visibleCapacity = count > 0 ? count : 1;
+    return true;
+}
 
-static const float HALF_FOV = FOV / 2;
+int getSpriteCount(void) {
+    return numSprites;
+}
 
-static sprite_t sprites[NUM_SPRITES] = {
-    {.x = 640, .y = 630, .textureIndex = TEXTURE_BARREL},
-    {.x = 250, .y = 600, .textureIndex = 11},
-    {.x = 300, .y = 400, .textureIndex = 12},
-};
+void freeSprites(void) {
+    free(sprites);
+    free(visibleSprites);
+    sprites = NULL;
+    visibleSprites = NULL;
+    numSprites = 0;
+    visibleCapacity = 0;
+}
+
+// Room for every sprite and entity to be in view, keeps the old room when out of memory
+static void reserveVisibleSprites(int count) {
+    if (count <= visibleCapacity) {
+        return;
+    }
+    sprite_t *grown = realloc(visibleSprites, count * sizeof(sprite_t));
+    if (grown == NULL) {
+        fprintf(stderr, "Out of memory sorting %d sprites, drawing fewer\n", count);
+        return;
+    }
+    visibleSprites = grown;
+    visibleCapacity = count;
+}
 
 static inline bool isWithinWindowBounds(int x, int y) {
-    return x > 0 & x < WINDOW_WIDTH & y > 0 & y < WINDOW_HEIGHT;
+    return x > 0 & x < config.renderWidth & y > 0 & y < config.renderHeight;
 }
 
 void renderMapSprites(void) {
-    for (int i = 0; i < NUM_SPRITES; i++) {
+    for (int i = 0; i < numSprites; i++) {
         drawRect(
             sprites[i].x * MINIMAP_SCALE_FACTOR,
             sprites[i].y * MINIMAP_SCALE_FACTOR,
@@ -43,34 +96,68 @@ static int compareSpriteDistance(const void *elem1, const void *elem2) {
     return s2->distance - s1->distance;
 }
 
-void renderSpriteProjection(void) {
-    sprite_t visibleSprites[NUM_SPRITES];
-    uint8_t numVisibleSprites = 0;
+// Fills in the angle and distance of a sprite inside our FOV, false when it is not
+static bool isSpriteInView(const camera_t *camera, sprite_t *sprite) {
+    float angleSpritePlayer = camera->angle - atan2f(sprite->y - camera->y, sprite->x - camera->x);
 
-    // Find sprites that are visible (inside our FOV)
-    for (int i = 0; i < NUM_SPRITES; i++) {
-        float angleSpritePlayer = player.rotationAngle - atan2f(sprites[i].y - player.y, sprites[i].x - player.x);
+    // Make sure the angle is always between 0 and 180 degrees
+    if (angleSpritePlayer > PI) {
+        angleSpritePlayer -= TWO_PI;
+    }
+    if (angleSpritePlayer < -PI) {
+        angleSpritePlayer += TWO_PI;
+    }
+        
+    angleSpritePlayer = fabsf(angleSpritePlayer);
+
+    // If sprite angle is less than half the FOV plus a small error margin
+	const float EPSILON = 0.2;
+    if (angleSpritePlayer < config.fov / 2 + EPSILON) {
+        sprite->angle = angleSpritePlayer;
+        sprite->distance = distanceBetweenPoints(sprite->x, sprite->y, camera->x, camera->y);
+        return true;
+    }
+    return false;
+}
 
-        // Make sure the angle is always between 0 and 180 degrees
-        if (angleSpritePlayer > PI) {
-            angleSpritePlayer -= TWO_PI;
+// The sprite's texel hides the wall behind it in every plane
+static void setSpritePlanes(const view_t *view, size_t pixel, float depth, uint16_t id) {
+    setViewDepth(view, pixel, depth);
+    if (view->planes.tileIds != NULL) {
+        view->planes.tileIds[pixel] = 0;
+    }
+    if (view->planes.spriteIds != NULL) {
+        view->planes.spriteIds[pixel] = id;
+    }
+}
+
+void renderViewSprites(const view_t *view) {
+    int numVisibleSprites = 0;
+    const int renderWidth = view->width;
+    const int renderHeight = view->height;
+    const ray_t *rays = view->rays;
+    sprite_t *visibleSprites = view->visibleSprites;
+    const bool planes = hasViewPlanes(view);
+
+    // Find sprites that are visible (inside our FOV)
+    for (int i = 0; i < numSprites && numVisibleSprites < view->visibleCapacity; i++) {
+        sprite_t sprite = sprites[i];
+        const bool visible = isSpriteInView(&view->camera, &sprite);
+        if (view->markSprites) {
+            sprites[i].visible = visible;
         }
-        if (angleSpritePlayer < -PI) {
-            angleSpritePlayer += TWO_PI;
+        if (visible) {
+			visibleSprites[numVisibleSprites] = sprite;
+            numVisibleSprites++;
         }
-            
-        angleSpritePlayer = fabsf(angleSpritePlayer);
-
-        // If sprite angle is less than half the FOV plus a small error margin
-		const float EPSILON = 0.2;
-        if (angleSpritePlayer < HALF_FOV + EPSILON) {
-            sprites[i].visible = true;
-            sprites[i].angle = angleSpritePlayer;
-            sprites[i].distance = distanceBetweenPoints(sprites[i].x, sprites[i].y, player.x, player.y);
-			visibleSprites[numVisibleSprites] = sprites[i];
+    }
+
+    // Entities are read straight out of their arrays
+    for (int i = 0; i < entities.count && numVisibleSprites < view->visibleCapacity; i++) {
+        sprite_t sprite = {entities.x[i], entities.y[i], 0, 0, true, entities.texture[i], getViewSpriteId(numSprites + i)};
+        if (isSpriteInView(&view->camera, &sprite)) {
+            visibleSprites[numVisibleSprites] = sprite;
             numVisibleSprites++;
-        } else {
-            sprites[i].visible = false;
         }
     }
 
@@ -85,47 +172,67 @@ void renderSpriteProjection(void) {
 		const float perpDistance = sprite.distance * cosf(sprite.angle);
 
         // Calculate the projected sprite height and width (the same, as sprites are squared)
-        float spriteHeight = (TILE_SIZE / perpDistance) * DIST_PROJ_PLANE;
+        float spriteHeight = (TILE_SIZE / perpDistance) * view->distProjPlane;
         float spriteWidth = spriteHeight;
 
-        float spriteTopY = ((float) WINDOW_HEIGHT / 2) - (spriteHeight / 2);
+        float spriteTopY = ((float) renderHeight / 2) - (spriteHeight / 2);
         if (spriteTopY < 0) {
             spriteTopY = 0;
         }
 
-        float spriteBottomY = ((float) WINDOW_HEIGHT / 2) + (spriteHeight / 2);
-        if (spriteBottomY > WINDOW_HEIGHT) {
-            spriteBottomY = WINDOW_HEIGHT;
+        float spriteBottomY = ((float) renderHeight / 2) + (spriteHeight / 2);
+        if (spriteBottomY > renderHeight) {
+            spriteBottomY = renderHeight;
         }
 
         // Calculate the sprite x position in the projection plane
-        float spriteAngle = atan2f(sprite.y - player.y, sprite.x - player.x) - player.rotationAngle;
-        float spriteScreenPosX = tanf(spriteAngle) * DIST_PROJ_PLANE;
+        float spriteAngle = atan2f(sprite.y - view->camera.y, sprite.x - view->camera.x) - view->camera.angle;
+        float spriteScreenPosX = tanf(spriteAngle) * view->distProjPlane;
 
-        float spriteLeftX = ((float) WINDOW_WIDTH / 2) + spriteScreenPosX - (spriteWidth / 2);
+        float spriteLeftX = ((float) renderWidth / 2) + spriteScreenPosX - (spriteWidth / 2);
         float spriteRightX = spriteLeftX + spriteWidth;
 
         // Query the width and the height of the texture
-        int textureWidth = upng_get_width(textures[sprite.textureIndex]);
-		int textureHeight = upng_get_height(textures[sprite.textureIndex]);
-
-		for (int x = spriteLeftX; x < spriteRightX; x++) {
+        const texture_t *texture = getViewTexture(view, sprite.texture);
+        int textureWidth = texture->width;
+		int textureHeight = texture->height;
+
+		// Only the columns on screen, a sprite right in front of the camera is many screens wide
+		const int firstX = (int)spriteLeftX > 1 ? (int)spriteLeftX : 1;
+		for (int x = firstX; x < spriteRightX && x < renderWidth; x++) {
+			// A wall in front hides the whole column
+			if (sprite.distance >= rays[x].distance) {
+				continue;
+			}
 			float texelWidth = (textureWidth / spriteWidth);
-			int textureOffsetX = (x - spriteLeftX) * texelWidth;
+			// The first column starts left of the sprite's edge, it takes the edge's texels
+			int textureOffsetX = x > spriteLeftX ? (x - spriteLeftX) * texelWidth : 0;
 
 			for (int y = spriteTopY; y < spriteBottomY; y++) {
-				if (x > 0 && x < WINDOW_WIDTH && y > 0 && y < WINDOW_HEIGHT) {
-					int distanceFromTop = y + (spriteHeight / 2) - ((float)WINDOW_HEIGHT / 2);
+				if (x > 0 && x < renderWidth && y > 0 && y < renderHeight) {
+					int distanceFromTop = y + (spriteHeight / 2) - ((float)renderHeight / 2);
 					int textureOffsetY = distanceFromTop * (textureHeight / spriteHeight);
 
-					color_t *spriteTextureBuffer = (color_t *)upng_get_buffer(textures[sprite.textureIndex]);
-					color_t texelColor = spriteTextureBuffer[(textureWidth * textureOffsetY) + textureOffsetX];
+					color_t texelColor = getTexel(texture, (textureWidth * textureOffsetY) + textureOffsetX);
 
-					if (sprite.distance < rays[x].distance && texelColor != 0xFFFF00FF) {
-						drawPixel(x, y, texelColor);
+					if (sprite.distance < rays[x].distance && texelColor != TRANSPARENT_COLOR) {
+						view->pixels[y * view->pitch + x] = texelColor;
+						if (planes) {
+							setSpritePlanes(view, (size_t)y * view->pitch + x, perpDistance, sprite.id);
+						}
 					}
 				}
 			}
 		}
 	}   
-}
\ No newline at end of file
+}
+
+void renderSpriteProjection(void) {
+    view_t view;
+    getScreenView(&view);
+    reserveVisibleSprites(numSprites + entities.count);
+    view.visibleSprites = visibleSprites;
+    view.visibleCapacity = visibleCapacity;
+    view.markSprites = true;
+    renderViewSprites(&view);
+}
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "textures.h"
 
 typedef struct sprite_t {
 	float x;
@@ -10,9 +11,20 @@ typedef struct sprite_t {
 	float distance;
 	float angle;
 	bool visible;
-	uint8_t textureIndex;
+	texture_handle_t texture;
+	uint16_t id;			// getViewSpriteId, for the sprite ID plane
 } sprite_t;
 
+// Replaces the sprites by the ones the current map places
+bool createSprites(void);
+void freeSprites(void);
+int getSpriteCount(void);
+
+struct view_t;
+
+// Draws the map sprites and entities in view over the walls, after renderViewWalls
+void renderViewSprites(const struct view_t *view);
+// renderViewSprites for the screen view, also updates the map sprites' visible flag
 void renderSpriteProjection(void);
 void renderMapSprites(void);
 
@@ -0,0 +1,69 @@
+#include "texpack.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool isValidPack(const texture_pack_t *pack, const char *fileName) {
+	const texpack_header_t *header = pack->header;
+	if (pack->file.size < sizeof(texpack_header_t) || memcmp(header->magic, TEXPACK_MAGIC, 4) != 0) {
+		fprintf(stderr, "Not a texture pack=%s\n", fileName);
+		return false;
+	}
+	if (header->version != TEXPACK_VERSION || header->byteOrder != TEXPACK_BYTE_ORDER) {
+		fprintf(stderr, "Texture pack=%s was written by another version or byte order, rebuild it\n", fileName);
+		return false;
+	}
+	if (header->numTextures > (pack->file.size - sizeof(texpack_header_t)) / sizeof(texpack_entry_t)) {
+		fprintf(stderr, "Truncated texture pack=%s\n", fileName);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header->numTextures; i++) {
+		const texpack_entry_t *entry = &pack->entries[i];
+		const uint64_t numTexels = (uint64_t)entry->width * entry->height;
+		const uint64_t size = entry->paletteSize > 0 ? entry->paletteSize * sizeof(color_t) + numTexels : numTexels * sizeof(color_t);
+		if (entry->paletteSize > 256 || entry->offset % TEXPACK_ALIGNMENT != 0 || entry->offset > pack->file.size || size > pack->file.size - entry->offset || entry->name[TEXPACK_NAME_LENGTH - 1] != '\0') {
+			fprintf(stderr, "Corrupt entry %u in texture pack=%s\n", i, fileName);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool openTexturePack(const char *fileName, texture_pack_t *pack) {
+	memset(pack, 0, sizeof(*pack));
+	mapped_file_t file;
+	if (!mapFile(fileName, &file)) {
+		if (errno != ENOENT) {
+			fprintf(stderr, "Could not map texture pack=%s\n", fileName);
+		}
+		return false;
+	}
+
+	pack->file = file;
+	pack->header = file.data;
+	pack->entries = (const texpack_entry_t *)(pack->header + 1);
+	if (!isValidPack(pack, fileName)) {
+		closeTexturePack(pack);
+		return false;
+	}
+	return true;
+}
+
+void closeTexturePack(texture_pack_t *pack) {
+	unmapFile(&pack->file);
+	memset(pack, 0, sizeof(*pack));
+}
+
+const texpack_entry_t *findPackedTexture(const texture_pack_t *pack, const char *name) {
+	for (uint32_t i = 0; i < pack->header->numTextures; i++) {
+		if (strncmp(pack->entries[i].name, name, TEXPACK_NAME_LENGTH) == 0) {
+			return &pack->entries[i];
+		}
+	}
+	return NULL;
+}
+
+const uint8_t *getPackedData(const texture_pack_t *pack, const texpack_entry_t *entry) {
+	return (const uint8_t *)pack->file.data + entry->offset;
+}
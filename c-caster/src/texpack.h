@@ -0,0 +1,52 @@
+#ifndef TEXPACK_H
+#define TEXPACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "graphics.h"
+#include "mapfile.h"
+
+// Texture pack: the decoded texels of every texture in a single file that is mapped into memory
+// and used in place, instead of decoding the PNGs at startup. Written by raycast-pack in the byte
+// order of the machine that wrote it.
+//
+// Layout: a texpack_header_t, numTextures texpack_entry_t, then the texels of each texture at an
+// offset aligned to TEXPACK_ALIGNMENT: RGBA32 rows (color_t), or for an indexed texture its
+// paletteSize colors followed by rows of one palette index per texel.
+#define TEXPACK_MAGIC "RCTP"
+#define TEXPACK_VERSION 2
+#define TEXPACK_BYTE_ORDER 0x01020304
+#define TEXPACK_ALIGNMENT 64
+#define TEXPACK_NAME_LENGTH 48
+
+typedef struct texpack_header_t {
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t numTextures;
+} texpack_header_t;
+
+typedef struct texpack_entry_t {
+	char name[TEXPACK_NAME_LENGTH]; // the texture's source file, zero padded
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;
+	uint32_t paletteSize; // 0 for RGBA32 texels
+	uint32_t reserved;
+} texpack_entry_t;
+
+typedef struct texture_pack_t {
+	mapped_file_t file;
+	const texpack_header_t *header;
+	const texpack_entry_t *entries;
+} texture_pack_t;
+
+// Maps the pack read-only and checks that every entry lies within the file. Returns false
+// without a message when the file does not exist.
+bool openTexturePack(const char *fileName, texture_pack_t *pack);
+void closeTexturePack(texture_pack_t *pack);
+const texpack_entry_t *findPackedTexture(const texture_pack_t *pack, const char *name);
+const uint8_t *getPackedData(const texture_pack_t *pack, const texpack_entry_t *entry);
+
+#endif
@@ -1,10 +1,22 @@
+#define _POSIX_C_SOURCE 200112L
+
 #include "textures.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "config.h"
 #include "defs.h"
+#include "jobs.h"
+#include "mapfile.h"
+#include "palette.h"
+#include "profiler.h"
+#include "texpack.h"
 #include "upng.h"
+#include "watcher.h"
 
-static const char *textureFileNames[NUM_TEXTURES] = {
+static const char *builtinTextureFileNames[] = {
     "./images/redbrick.png",
     "./images/purplestone.png",
     "./images/mossystone.png",
@@ -21,28 +33,523 @@ static const char *textureFileNames[NUM_TEXTURES] = {
     "./images/armor.png"
 };
 
-upng_t *textures[NUM_TEXTURES];
+#define NUM_BUILTIN_TEXTURES (int)(sizeof(builtinTextureFileNames) / sizeof(builtinTextureFileNames[0]))
+
+typedef enum texture_state_t {
+    TEXTURE_UNLOADED,
+    TEXTURE_QUEUED,     // waiting for or being decoded by the streaming thread
+    TEXTURE_RESIDENT,   // decoded texels on the heap, counted against the budget
+    TEXTURE_PACKED,     // texels in the mapped pack, never evicted
+    TEXTURE_FAILED
+} texture_state_t;
+
+typedef struct texture_entry_t {
+    char *fileName;
+    texture_state_t state;
+    texture_t texture;
+    uint64_t lastUsedFrame;
+    bool reloadPending;     // its PNG changed on disk, waiting for room in the stream queue
+} texture_entry_t;
+
+// A decode handed to another thread, whoever installs the result owns the texels
+typedef struct texture_request_t {
+    texture_handle_t handle;
+    const char *fileName;
+    bool reload;            // replaces the texels of a ready texture instead of being dropped
+    upng_error error;
+    unsigned errorLine;
+    texture_t texture;
+} texture_request_t;
+
+static texture_entry_t *entries = NULL;
+static int numEntries = 0;
+static int entryCapacity = 0;
+
+static size_t residentBytes = 0;
+static size_t peakBytes = 0;
+static size_t budgetBytes = 0;
+static int numEvictions = 0;
+static uint64_t cacheFrame = 0;
+static int numReloadsPending = 0;
+
+static texture_pack_t pack;
+static time_t packTime;
+
+// A checkerboard of 8 texel squares, drawn while a texture streams in
+static color_t placeholderTexels[TILE_SIZE * TILE_SIZE];
+static const texture_t placeholder = {.width = TILE_SIZE, .height = TILE_SIZE, .texels = placeholderTexels};
+
+// The streaming thread decodes the requests from decodedCount up to submitted, the render
+// thread takes in the results from collected up to decodedCount
+#define STREAM_QUEUE_SIZE 64
+static texture_request_t streamQueue[STREAM_QUEUE_SIZE];
+static uint64_t submitted = 0;
+static uint64_t decodedCount = 0;
+static uint64_t collected = 0;
+static pthread_t streamThread;
+static bool streaming = false;
+static bool stopStreaming = false;
+static pthread_mutex_t streamLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t streamReady = PTHREAD_COND_INITIALIZER;
+
+// Decoded textures are a single block each, indexed ones start with their palette
+static void freeTexels(const texture_t *texture) {
+    free(texture->indices != NULL ? (void *)texture->palette : (void *)texture->texels);
+}
+
+// Replaces the RGBA32 texels by a palette followed by a byte per texel
+static upng_error indexTexels(texture_t *texture) {
+    const int numTexels = texture->width * texture->height;
+    color_t palette[MAX_PALETTE_SIZE];
+    uint8_t *block = malloc(sizeof(palette) + numTexels);
+    const int paletteSize = block != NULL ? quantizeColors(texture->texels, numTexels, TRANSPARENT_COLOR, palette, block + sizeof(palette)) : 0;
+    if (paletteSize == 0) {
+        free(block);
+        return UPNG_ENOMEM;
+    }
+
+    // Close the gap the unused palette entries left and give it back
+    memcpy(block, palette, paletteSize * sizeof(color_t));
+    memmove(block + paletteSize * sizeof(color_t), block + sizeof(palette), numTexels);
+    uint8_t *shrunk = realloc(block, paletteSize * sizeof(color_t) + numTexels);
+    block = shrunk != NULL ? shrunk : block;
+    free((void *)texture->texels);
+    texture->texels = NULL;
+    texture->palette = (const color_t *)block;
+    texture->indices = block + paletteSize * sizeof(color_t);
+    texture->paletteSize = paletteSize;
+    return UPNG_EOK;
+}
+
+static upng_error decodeTexels(upng_t *upng, texture_t *texture) {
+    if (upng_header(upng) != UPNG_EOK) {
+        return upng_get_error(upng);
+    }
+    if (upng_get_format(upng) != UPNG_RGBA8) {
+        return UPNG_EUNFORMAT;
+    }
+
+    const unsigned long size = upng_get_output_size(upng);
+    color_t *texels = malloc(size);
+    if (texels == NULL) {
+        return UPNG_ENOMEM;
+    }
+    if (upng_decode_into(upng, (unsigned char *)texels, size) != UPNG_EOK) {
+        free(texels);
+        return upng_get_error(upng);
+    }
+    texture->width = upng_get_width(upng);
+    texture->height = upng_get_height(upng);
+    texture->texels = texels;
+    return UPNG_EOK;
+}
+
+// Maps the PNG and decodes it straight into a block of its own, on any thread
+static void decodeRequest(texture_request_t *request) {
+    const uint64_t zoneStart = profileBegin();
+    memset(&request->texture, 0, sizeof(request->texture));
+    request->errorLine = 0;
+
+    mapped_file_t source;
+    if (!mapFile(request->fileName, &source)) {
+        request->error = UPNG_ENOTFOUND;
+    } else {
+        upng_t *upng = upng_new_from_bytes(source.data, source.size);
+        request->error = upng != NULL ? decodeTexels(upng, &request->texture) : UPNG_ENOMEM;
+        if (request->error == UPNG_EOK && config.indexedTextures && indexTexels(&request->texture) != UPNG_EOK) {
+            freeTexels(&request->texture);
+            memset(&request->texture, 0, sizeof(request->texture));
+            request->error = UPNG_ENOMEM;
+        }
+        if (upng != NULL) {
+            request->errorLine = upng_get_error_line(upng);
+            upng_free(upng);
+        }
+        unmapFile(&source);
+    }
+    profileEnd(PROFILE_LOAD_TEXTURE, zoneStart);
+}
+
+static void reportDecodeError(const texture_request_t *request) {
+    if (request->error == UPNG_ENOTFOUND) {
+        fprintf(stderr, "Could not load png=%s\n", request->fileName);
+    } else if (request->error == UPNG_EUNFORMAT) {
+        fprintf(stderr, "Texture png=%s is not RGBA with 8 bits per channel\n", request->fileName);
+    } else {
+        fprintf(stderr, "Could not decode png=%s (error %d at line %d)\n", request->fileName, request->error, request->errorLine);
+    }
+}
+
+static bool isReady(const texture_entry_t *entry) {
+    return entry->state == TEXTURE_RESIDENT || entry->state == TEXTURE_PACKED;
+}
+
+// Takes ownership of the decoded texels. A texture that got ready some other way meanwhile
+// keeps the texels it has, unless this is a reload of its changed PNG.
+static bool installTexture(texture_request_t *request) {
+    texture_entry_t *entry = &entries[request->handle];
+    if (request->error != UPNG_EOK) {
+        // A failed reload, e.g. of a half written file, keeps showing the texture as it was
+        reportDecodeError(request);
+        if (!isReady(entry)) {
+            entry->state = TEXTURE_FAILED;
+        }
+        return false;
+    }
+    if (isReady(entry) && !request->reload) {
+        freeTexels(&request->texture);
+        return true;
+    }
+    if (entry->state == TEXTURE_RESIDENT) {
+        residentBytes -= getTextureSize(&entry->texture);
+        freeTexels(&entry->texture);
+    }
+
+    entry->texture = request->texture;
+    entry->state = TEXTURE_RESIDENT;
+    entry->lastUsedFrame = cacheFrame;
+    residentBytes += getTextureSize(&entry->texture);
+    if (residentBytes > peakBytes) {
+        peakBytes = residentBytes;
+    }
+    return true;
+}
+
+// Textures drawn in the last frame stay even when that leaves the cache over budget, evicting
+// them would only have them streamed in again right away
+static void evictLeastRecentlyUsed(void) {
+    while (budgetBytes > 0 && residentBytes > budgetBytes) {
+        texture_entry_t *oldest = NULL;
+        for (int i = 0; i < numEntries; i++) {
+            texture_entry_t *entry = &entries[i];
+            if (entry->state == TEXTURE_RESIDENT && entry->lastUsedFrame + 1 < cacheFrame && (oldest == NULL || entry->lastUsedFrame < oldest->lastUsedFrame)) {
+                oldest = entry;
+            }
+        }
+        if (oldest == NULL) {
+            return;
+        }
+
+        residentBytes -= getTextureSize(&oldest->texture);
+        freeTexels(&oldest->texture);
+        memset(&oldest->texture, 0, sizeof(oldest->texture));
+        oldest->state = TEXTURE_UNLOADED;
+        numEvictions++;
+    }
+}
+
+static void *streamMain(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&streamLock);
+    for (;;) {
+        while (!stopStreaming && decodedCount == submitted) {
+            pthread_cond_wait(&streamReady, &streamLock);
+        }
+        if (stopStreaming) {
+            break;
+        }
+        texture_request_t *request = &streamQueue[decodedCount % STREAM_QUEUE_SIZE];
+        pthread_mutex_unlock(&streamLock);
+
+        decodeRequest(request);
+
+        pthread_mutex_lock(&streamLock);
+        decodedCount++;
+    }
+    pthread_mutex_unlock(&streamLock);
+    return NULL;
+}
+
+// Returns false when the queue is full, the texture is queued again the next time it is drawn
+static bool queueTextureDecode(texture_handle_t handle, bool reload) {
+    pthread_mutex_lock(&streamLock);
+    const bool queued = submitted - collected < STREAM_QUEUE_SIZE;
+    if (queued) {
+        texture_request_t *request = &streamQueue[submitted % STREAM_QUEUE_SIZE];
+        request->handle = handle;
+        request->fileName = entries[handle].fileName;
+        request->reload = reload;
+        submitted++;
+        pthread_cond_signal(&streamReady);
+    }
+    pthread_mutex_unlock(&streamLock);
+    return queued;
+}
+
+// Ready textures keep being drawn as they are until their new texels are decoded, the others
+// simply decode the new file the next time they are drawn
+bool reloadTexture(const char *fileName) {
+    for (int i = 0; i < numEntries; i++) {
+        texture_entry_t *entry = &entries[i];
+        if (strcmp(entry->fileName, fileName) != 0) {
+            continue;
+        }
+        printf("png=%s changed, reloading\n", fileName);
+        if (entry->state == TEXTURE_FAILED) {
+            entry->state = TEXTURE_UNLOADED;
+        } else if (entry->state != TEXTURE_UNLOADED && !entry->reloadPending) {
+            entry->reloadPending = true;
+            numReloadsPending++;
+        }
+        return true;
+    }
+    return false;
+}
+
+static void queuePendingReloads(void) {
+    for (int i = 0; i < numEntries && numReloadsPending > 0; i++) {
+        if (entries[i].reloadPending && queueTextureDecode(i, true)) {
+            entries[i].reloadPending = false;
+            numReloadsPending--;
+        }
+    }
+}
+
+static void stopStreamingThread(void) {
+    if (!streaming) {
+        return;
+    }
+    pthread_mutex_lock(&streamLock);
+    stopStreaming = true;
+    pthread_cond_signal(&streamReady);
+    pthread_mutex_unlock(&streamLock);
+    pthread_join(streamThread, NULL);
+
+    // Decodes that finished after the last frame took its results in
+    for (; collected < decodedCount; collected++) {
+        freeTexels(&streamQueue[collected % STREAM_QUEUE_SIZE].texture);
+    }
+    submitted = decodedCount = collected = 0;
+    streaming = false;
+    stopStreaming = false;
+}
+
+// The pack is ignored for a PNG edited after it was written, so an edit never shows stale texels
+static void usePackedTexture(texture_entry_t *entry) {
+    struct stat imageStatus;
+    if (pack.header == NULL) {
+        return;
+    }
+    if (stat(entry->fileName, &imageStatus) == 0 && imageStatus.st_mtime > packTime) {
+        printf("Texture pack is older than png=%s, decoding it instead\n", entry->fileName);
+        return;
+    }
+    const texpack_entry_t *packed = findPackedTexture(&pack, entry->fileName);
+    if (packed != NULL) {
+        const uint8_t *data = getPackedData(&pack, packed);
+        entry->texture.width = packed->width;
+        entry->texture.height = packed->height;
+        if (packed->paletteSize > 0) {
+            entry->texture.palette = (const color_t *)data;
+            entry->texture.indices = data + packed->paletteSize * sizeof(color_t);
+            entry->texture.paletteSize = packed->paletteSize;
+        } else {
+            entry->texture.texels = (const color_t *)data;
+        }
+        entry->state = TEXTURE_PACKED;
+    }
+}
+
+static bool mapTexturePack(const char *fileName) {
+    struct stat packStatus;
+    if (stat(fileName, &packStatus) != 0 || !openTexturePack(fileName, &pack)) {
+        return false;
+    }
+    packTime = packStatus.st_mtime;
+    printf("Texture pack=%s mapped\n", fileName);
+    return true;
+}
+
+texture_handle_t findTexture(const char *fileName) {
+    for (int i = 0; i < numEntries; i++) {
+        if (strcmp(entries[i].fileName, fileName) == 0) {
+            return i;
+        }
+    }
+
+    if (numEntries == entryCapacity) {
+        const int capacity = entryCapacity > 0 ? entryCapacity * 2 : 64;
+        texture_entry_t *grown = realloc(entries, capacity * sizeof(texture_entry_t));
+        if (grown == NULL) {
+            fprintf(stderr, "Out of memory registering png=%s\n", fileName);
+            return INVALID_TEXTURE_HANDLE;
+        }
+        entries = grown;
+        entryCapacity = capacity;
+    }
+
+    texture_entry_t *entry = &entries[numEntries];
+    memset(entry, 0, sizeof(*entry));
+    entry->fileName = malloc(strlen(fileName) + 1);
+    if (entry->fileName == NULL) {
+        fprintf(stderr, "Out of memory registering png=%s\n", fileName);
+        return INVALID_TEXTURE_HANDLE;
+    }
+    strcpy(entry->fileName, fileName);
+    entry->state = TEXTURE_UNLOADED;
+    usePackedTexture(entry);
+    if (isFileWatcherRunning()) {
+        watchFile(fileName);
+    }
+    return numEntries++;
+}
+
+static bool registerBuiltinTextures(void) {
+    for (int y = 0; y < TILE_SIZE; y++) {
+        for (int x = 0; x < TILE_SIZE; x++) {
+            placeholderTexels[y * TILE_SIZE + x] = ((x >> 3) + (y >> 3)) % 2 ? 0xFF505050 : 0xFF303030;
+        }
+    }
+    for (int i = 0; i < NUM_BUILTIN_TEXTURES; i++) {
+        if (findTexture(builtinTextureFileNames[i]) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int getTextureCount(void) {
+    return numEntries;
+}
+
+const char *getTextureFileName(texture_handle_t handle) {
+    return entries[handle].fileName;
+}
+
+bool isTextureReady(texture_handle_t handle) {
+    return handle >= 0 && handle < numEntries && isReady(&entries[handle]);
+}
+
+const texture_t *peekTexture(texture_handle_t handle) {
+    return isTextureReady(handle) ? &entries[handle].texture : &placeholder;
+}
+
+const texture_t *getTexture(texture_handle_t handle) {
+    if (handle < 0 || handle >= numEntries) {
+        return &placeholder;
+    }
+    texture_entry_t *entry = &entries[handle];
+    entry->lastUsedFrame = cacheFrame;
+    if (isReady(entry)) {
+        return &entry->texture;
+    }
+    if (entry->state == TEXTURE_UNLOADED && streaming && queueTextureDecode(handle, false)) {
+        entry->state = TEXTURE_QUEUED;
+    }
+    return &placeholder;
+}
+
+void updateTextureCache(void) {
+    cacheFrame++;
+    queuePendingReloads();
+    pthread_mutex_lock(&streamLock);
+    const uint64_t end = decodedCount;
+    pthread_mutex_unlock(&streamLock);
+
+    for (uint64_t i = collected; i < end; i++) {
+        installTexture(&streamQueue[i % STREAM_QUEUE_SIZE]);
+    }
+
+    // Only now can the streaming thread reuse the slots
+    pthread_mutex_lock(&streamLock);
+    collected = end;
+    pthread_mutex_unlock(&streamLock);
+    evictLeastRecentlyUsed();
+}
+
+void getTextureCacheStats(texture_cache_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->numTextures = numEntries;
+    for (int i = 0; i < numEntries; i++) {
+        stats->numResident += entries[i].state == TEXTURE_RESIDENT;
+    }
+    stats->residentBytes = residentBytes;
+    stats->peakBytes = peakBytes;
+    stats->budgetBytes = budgetBytes;
+    stats->numEvictions = numEvictions;
+}
+
+bool loadTextures(void) {
+    budgetBytes = (size_t)config.textureBudgetMb << 20;
+    mapTexturePack(TEXTURE_PACK_FILE);
+    if (config.hotReload) {
+        startFileWatcher();
+    }
+    if (!registerBuiltinTextures()) {
+        freeTextures();
+        return false;
+    }
+    if (pthread_create(&streamThread, NULL, streamMain, NULL) != 0) {
+        fprintf(stderr, "Could not start the texture streaming thread\n");
+        freeTextures();
+        return false;
+    }
+    streaming = true;
+    return true;
+}
 
-void loadTextures(void) {
-    for (int i = 0; i < NUM_TEXTURES; i++) {
-        upng_t *upng = upng_new_from_file(textureFileNames[i]);
-        if(upng == NULL) {
-            fprintf(stderr, "Could not load png=%s\n", textureFileNames[i]);
-            exit(EXIT_FAILURE);
+// Runs on the job workers, each texture is read and inflated independently
+static void decodePreloadRequest(void *data, int index) {
+    decodeRequest(&((texture_request_t *)data)[index]);
+}
+
+bool preloadTextures(void) {
+    texture_request_t *requests = malloc((numEntries > 0 ? numEntries : 1) * sizeof(texture_request_t));
+    if (requests == NULL) {
+        fprintf(stderr, "Out of memory preloading textures\n");
+        return false;
+    }
+    int numRequests = 0;
+    for (int i = 0; i < numEntries; i++) {
+        if (!isReady(&entries[i])) {
+            requests[numRequests].handle = i;
+            requests[numRequests].fileName = entries[i].fileName;
+            requests[numRequests].reload = false;
+            numRequests++;
         }
-        upng_decode(upng);
-        if (upng_get_error(upng) == UPNG_EOK) {
-            textures[i] = upng;
-            printf("png=%s decoded\n", textureFileNames[i]);
+    }
+
+    parallelFor(numRequests, decodePreloadRequest, requests);
+
+    // Report every texture that failed, not just the first one
+    int failures = 0;
+    for (int i = 0; i < numRequests; i++) {
+        if (installTexture(&requests[i])) {
+            printf("png=%s decoded\n", requests[i].fileName);
         } else {
-            fprintf(stderr, "Could not decode png=%s\n", textureFileNames[i]);
-            exit(EXIT_FAILURE);
+            failures++;
         }
     }
+    free(requests);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d of %d textures failed to load\n", failures, numEntries);
+        return false;
+    }
+    return true;
+}
+
+bool decodeTextures(void) {
+    if (!registerBuiltinTextures() || !preloadTextures()) {
+        freeTextures();
+        return false;
+    }
+    return true;
 }
 
 void freeTextures(void) {
-    for (int i = 0; i < NUM_TEXTURES; i++) {
-        upng_free(textures[i]);
+    stopFileWatcher();
+    stopStreamingThread();
+    for (int i = 0; i < numEntries; i++) {
+        if (entries[i].state == TEXTURE_RESIDENT) {
+            freeTexels(&entries[i].texture);
+        }
+        free(entries[i].fileName);
     }
-}
\ No newline at end of file
+    free(entries);
+    entries = NULL;
+    numEntries = entryCapacity = 0;
+    numReloadsPending = 0;
+    residentBytes = 0;
+    closeTexturePack(&pack);
+}
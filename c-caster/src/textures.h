@@ -1,13 +1,76 @@
 #ifndef TEXTURES_H
 #define TEXTURES_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "defs.h"
-#include "upng.h"
+#include "graphics.h"
 
-extern upng_t *textures[NUM_TEXTURES];
+// Render-ready texels in rows of width * height, either RGBA32 or one byte per texel indexing
+// a palette of up to 256 colors (see --indexed-textures)
+typedef struct texture_t {
+	int width;
+	int height;
+	const color_t *texels;		// NULL when indexed
+	const uint8_t *indices;		// NULL when RGBA32
+	const color_t *palette;
+	int paletteSize;
+} texture_t;
 
-void loadTextures(void);
+static inline color_t getTexel(const texture_t *texture, int index) {
+	return texture->indices != NULL ? texture->palette[texture->indices[index]] : texture->texels[index];
+}
+
+// Bytes of texels and palette
+static inline size_t getTextureSize(const texture_t *texture) {
+	const size_t numTexels = (size_t)texture->width * texture->height;
+	return texture->indices != NULL ? numTexels + texture->paletteSize * sizeof(color_t) : numTexels * sizeof(color_t);
+}
+
+// Textures are referred to by handle. The built-in textures are registered first, so their
+// handles are the map tile values minus one.
+typedef int texture_handle_t;
+#define INVALID_TEXTURE_HANDLE -1
+
+typedef struct texture_cache_stats_t {
+	int numTextures;		// registered
+	int numResident;		// decoded on the heap, packed textures are not counted
+	size_t residentBytes;
+	size_t peakBytes;
+	size_t budgetBytes;		// 0 when unlimited
+	int numEvictions;
+} texture_cache_stats_t;
+
+// Registers the built-in textures, maps the texture pack when there is an up to date one and
+// starts streaming: anything not in the pack is decoded in the background on first use, within
+// config.textureBudgetMb. Returns false if streaming could not start.
+bool loadTextures(void);
+// Decodes every registered texture that is not ready yet on the job workers and waits for them.
+// Returns false after reporting every texture that failed.
+bool preloadTextures(void);
+// Registers and decodes the built-in textures, ignoring any texture pack
+bool decodeTextures(void);
 void freeTextures(void);
 
-#endif
\ No newline at end of file
+// Returns the handle of an already registered file, registering it otherwise
+texture_handle_t findTexture(const char *fileName);
+int getTextureCount(void);
+const char *getTextureFileName(texture_handle_t handle);
+
+// Render thread only. Returns a placeholder until the texture is decoded and queues its decode
+// on first use. The pointer is valid until the next findTexture or updateTextureCache.
+const texture_t *getTexture(texture_handle_t handle);
+// getTexture without marking the texture used or queueing its decode, for looking textures up
+// ahead of frames that may not draw them
+const texture_t *peekTexture(texture_handle_t handle);
+bool isTextureReady(texture_handle_t handle);
+
+// Once per frame before rendering: takes in the textures streamed since the last frame and
+// evicts the least recently used ones while over the budget
+void updateTextureCache(void);
+// Reloads the texture of a PNG that changed on disk in the background, false if no texture uses it
+bool reloadTexture(const char *fileName);
+void getTextureCacheStats(texture_cache_stats_t *stats);
+
+#endif
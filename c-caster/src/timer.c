@@ -0,0 +1,10 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "timer.h"
+#include <time.h>
+
+uint64_t getTimestampNs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
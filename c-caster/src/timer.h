@@ -0,0 +1,9 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// Monotonic timestamp in nanoseconds, only meaningful as a difference between two calls
+uint64_t getTimestampNs(void);
+
+#endif
@@ -27,6 +27,7 @@ freely, subject to the following restrictions:
 #include "upng.h"
 
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,17 +46,10 @@ freely, subject to the following restrictions:
 #define NUM_DEFLATE_CODE_SYMBOLS 288 /*256 literals, the end code, some length codes, and 2 unused codes */
 #define NUM_DISTANCE_SYMBOLS 32		 /*the distance codes have their own symbols, 30 used, 2 unused */
 #define NUM_CODE_LENGTH_CODES 19	 /*the code length codes. 0-15: code lengths, 16: copy previous 3-6 times, 17: 3-10 zeros, 18: 11-138 zeros */
-#define MAX_SYMBOLS 288				 /* largest number of symbols used by any tree type */
 
-#define DEFLATE_CODE_BITLEN 15
-#define DISTANCE_BITLEN 15
 #define CODE_LENGTH_BITLEN 7
 #define MAX_BIT_LENGTH 15 /* largest bitlen used by any tree type */
 
-#define DEFLATE_CODE_BUFFER_SIZE (NUM_DEFLATE_CODE_SYMBOLS * 2)
-#define DISTANCE_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
-#define CODE_LENGTH_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
-
 #define SET_ERROR(upng, code)          \
 	do {                               \
 		(upng)->error = (code);        \
@@ -86,6 +80,7 @@ struct upng_t {
 
 	unsigned char* buffer;
 	unsigned long size;
+	int buffer_owning; /* 0 when the image was decoded into memory of the caller */
 
 	upng_error error;
 	unsigned error_line;
@@ -94,11 +89,30 @@ struct upng_t {
 	upng_source source;
 };
 
-typedef struct huffman_tree {
-	unsigned* tree2d;
-	unsigned maxbitlen; /*maximum number of bits a single code can get */
-	unsigned numcodes;	/*number of symbols in the alphabet = number of codes */
-} huffman_tree;
+/* a Huffman code as lookup tables: the first rootbits bits of the input index the root table, codes
+   longer than that continue in a subtable indexed by the following bits. Entries are 0 for bit
+   patterns no code starts with, otherwise the value in bits 0-15, a bit count in bits 16-20 and a
+   flag: a symbol with its full code length, or a link to the subtable at value indexed by that many bits */
+#define HUFFMAN_ROOT_BITS 10
+#define HUFFMAN_TABLE_SIZE 2048 /* root table plus subtables, enough for any code that isn't oversubscribed */
+#define HUFFMAN_SYMBOL 0x80000000u
+#define HUFFMAN_LINK 0x40000000u
+#define HUFFMAN_VALUE(entry) ((entry) & 0xFFFF)
+#define HUFFMAN_BITS(entry) (((entry) >> 16) & 0x1F)
+
+typedef struct huffman_table {
+	uint32_t entries[HUFFMAN_TABLE_SIZE];
+	unsigned rootbits;
+} huffman_table;
+
+/* reads the deflate stream least significant bit first through a 64-bit buffer, refilled a byte at a time */
+typedef struct bit_reader {
+	const unsigned char* in;
+	unsigned long size;
+	unsigned long pos;	/* next byte to move into the buffer */
+	uint64_t buffer;
+	unsigned count;		/* valid bits in the buffer */
+} bit_reader;
 
 static const unsigned LENGTH_BASE[29] = {/*the base lengths represented by codes 257-285 */
 										 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
@@ -115,157 +129,198 @@ static const unsigned DISTANCE_EXTRA[30] = {/*the extra bits of backwards distan
 static const unsigned CLCL[NUM_CODE_LENGTH_CODES] /*the order in which "code length alphabet code lengths" are stored, out of this the huffman tree of the dynamic huffman tree lengths is generated */
 	= {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
 
-static const unsigned FIXED_DEFLATE_CODE_TREE[NUM_DEFLATE_CODE_SYMBOLS * 2] = {289, 370, 290, 307, 546, 291, 561, 292, 293, 300, 294, 297, 295, 296, 0,	  1,   2,	3,	 298, 299, 4,	5,	 6,	  7,   301, 304, 302, 303, 8,	9,	 10,  11,  305, 306, 12,  13,  14,	15,	 308, 339, 309, 324, 310, 317, 311, 314, 312, 313, 16,	17,	 18,  19,  315, 316, 20,  21,  22,	23,	 318, 321, 319, 320, 24,  25,  26,	27,	 322, 323, 28,	29,	 30,  31,  325, 332, 326, 329, 327, 328, 32,  33,  34,	35,	 330, 331, 36,	37,	 38,  39,  333, 336, 334, 335, 40,	41,	 42,  43,  337, 338, 44,  45,  46,	47,	 340, 355, 341, 348, 342, 345, 343, 344, 48,  49,  50,	51,	 346, 347, 52,	53,	 54,  55,  349, 352, 350, 351, 56,	57,	 58,  59,  353, 354, 60,  61,  62,	63,	 356, 363, 357, 360, 358, 359, 64,	65,	 66,  67,
-																			   361, 362, 68,  69,  70,	71,	 364, 367, 365, 366, 72,  73,  74,	75,	 368, 369, 76,	77,	 78,  79,  371, 434, 372, 403, 373, 388, 374, 381, 375, 378, 376, 377, 80,	81,	 82,  83,  379, 380, 84,  85,  86,	87,	 382, 385, 383, 384, 88,  89,  90,	91,	 386, 387, 92,	93,	 94,  95,  389, 396, 390, 393, 391, 392, 96,  97,  98,	99,	 394, 395, 100, 101, 102, 103, 397, 400, 398, 399, 104, 105, 106, 107, 401, 402, 108, 109, 110, 111, 404, 419, 405, 412, 406, 409, 407, 408, 112, 113, 114, 115, 410, 411, 116, 117, 118, 119, 413, 416, 414, 415, 120, 121, 122, 123, 417, 418, 124, 125, 126, 127, 420, 427, 421, 424, 422, 423, 128, 129, 130, 131, 425, 426, 132, 133, 134, 135, 428, 431, 429, 430, 136, 137, 138, 139, 432, 433,
-																			   140, 141, 142, 143, 435, 483, 436, 452, 568, 437, 438, 445, 439, 442, 440, 441, 144, 145, 146, 147, 443, 444, 148, 149, 150, 151, 446, 449, 447, 448, 152, 153, 154, 155, 450, 451, 156, 157, 158, 159, 453, 468, 454, 461, 455, 458, 456, 457, 160, 161, 162, 163, 459, 460, 164, 165, 166, 167, 462, 465, 463, 464, 168, 169, 170, 171, 466, 467, 172, 173, 174, 175, 469, 476, 470, 473, 471, 472, 176, 177, 178, 179, 474, 475, 180, 181, 182, 183, 477, 480, 478, 479, 184, 185, 186, 187, 481, 482, 188, 189, 190, 191, 484, 515, 485, 500, 486, 493, 487, 490, 488, 489, 192, 193, 194, 195, 491, 492, 196, 197, 198, 199, 494, 497, 495, 496, 200, 201, 202, 203, 498, 499, 204, 205, 206, 207, 501, 508, 502, 505, 503, 504, 208, 209,
-																			   210, 211, 506, 507, 212, 213, 214, 215, 509, 512, 510, 511, 216, 217, 218, 219, 513, 514, 220, 221, 222, 223, 516, 531, 517, 524, 518, 521, 519, 520, 224, 225, 226, 227, 522, 523, 228, 229, 230, 231, 525, 528, 526, 527, 232, 233, 234, 235, 529, 530, 236, 237, 238, 239, 532, 539, 533, 536, 534, 535, 240, 241, 242, 243, 537, 538, 244, 245, 246, 247, 540, 543, 541, 542, 248, 249, 250, 251, 544, 545, 252, 253, 254, 255, 547, 554, 548, 551, 549, 550, 256, 257, 258, 259, 552, 553, 260, 261, 262, 263, 555, 558, 556, 557, 264, 265, 266, 267, 559, 560, 268, 269, 270, 271, 562, 565, 563, 564, 272, 273, 274, 275, 566, 567, 276, 277, 278, 279, 569, 572, 570, 571, 280, 281, 282, 283, 573, 574, 284, 285, 286, 287, 0,	  0};
+static void bits_init(bit_reader* bits, const unsigned char* in, unsigned long size) {
+	bits->in = in;
+	bits->size = size;
+	bits->pos = 0;
+	bits->buffer = 0;
+	bits->count = 0;
+}
 
-static const unsigned FIXED_DISTANCE_TREE[NUM_DISTANCE_SYMBOLS * 2] = {33, 48, 34, 41, 35, 38, 36, 37, 0, 1, 2, 3, 39, 40, 4, 5, 6, 7, 42, 45, 43, 44, 8, 9, 10, 11, 46, 47, 12, 13, 14, 15, 49, 56, 50, 53, 51, 52, 16, 17, 18, 19, 54, 55, 20, 21, 22, 23, 57, 60, 58, 59, 24, 25, 26, 27, 61, 62, 28, 29, 30, 31, 0, 0};
+/* tops the buffer up to at least 56 bits, or to whatever is left of the input */
+static void bits_refill(bit_reader* bits) {
+	if (bits->pos + 8 <= bits->size) {
+		const unsigned char* p = &bits->in[bits->pos];
+		uint64_t word = (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 | (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+		bits->buffer |= word << bits->count;
+		bits->pos += (63 - bits->count) >> 3;
+		bits->count |= 56;
+		return;
+	}
+	while (bits->count <= 56 && bits->pos < bits->size) {
+		bits->buffer |= (uint64_t)bits->in[bits->pos++] << bits->count;
+		bits->count += 8;
+	}
+}
 
-static unsigned char read_bit(unsigned long* bitpointer, const unsigned char* bitstream) {
-	unsigned char result = (unsigned char)((bitstream[(*bitpointer) >> 3] >> ((*bitpointer) & 0x7)) & 1);
-	(*bitpointer)++;
-	return result;
+static void bits_consume(bit_reader* bits, unsigned nbits) {
+	bits->buffer >>= nbits;
+	bits->count -= nbits;
 }
 
-static unsigned read_bits(unsigned long* bitpointer, const unsigned char* bitstream, unsigned long nbits) {
-	unsigned result = 0, i;
-	for (i = 0; i < nbits; i++) result |= ((unsigned)read_bit(bitpointer, bitstream)) << i;
+/* reads up to 32 bits, reading past the end of the input is an error */
+static unsigned bits_read(upng_t* upng, bit_reader* bits, unsigned nbits) {
+	unsigned result;
+	if (nbits == 0) {
+		return 0;
+	}
+	if (bits->count < nbits) {
+		bits_refill(bits);
+		if (bits->count < nbits) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			return 0;
+		}
+	}
+	result = (unsigned)(bits->buffer & ((1ull << nbits) - 1));
+	bits_consume(bits, nbits);
 	return result;
 }
 
-/* the buffer must be numcodes*2 in size! */
-static void huffman_tree_init(huffman_tree* tree, unsigned* buffer, unsigned numcodes, unsigned maxbitlen) {
-	tree->tree2d = buffer;
+/* drops the bits up to the next byte boundary and hands whole buffered bytes back to the input */
+static void bits_align_to_byte(bit_reader* bits) {
+	bits_consume(bits, bits->count & 7);
+	bits->pos -= bits->count >> 3;
+	bits->buffer = 0;
+	bits->count = 0;
+}
 
-	tree->numcodes = numcodes;
-	tree->maxbitlen = maxbitlen;
+static unsigned reverse_bits(unsigned code, unsigned length) {
+	unsigned result = 0, i;
+	for (i = 0; i < length; i++) {
+		result = (result << 1) | ((code >> i) & 1);
+	}
+	return result;
 }
 
-/*given the code lengths (as stored in the PNG file), generate the tree as defined by Deflate. maxbitlen is the maximum bits that a code in the tree can have. return value is error.*/
-static void huffman_tree_create_lengths(upng_t* upng, huffman_tree* tree, const unsigned* bitlen) {
-	unsigned tree1d[MAX_SYMBOLS];
-	unsigned blcount[MAX_BIT_LENGTH];
+/*given the code lengths (as stored in the PNG file), generate the lookup tables of the canonical code as defined by Deflate*/
+static void huffman_table_create_lengths(upng_t* upng, huffman_table* table, const unsigned* bitlen, unsigned numcodes, unsigned rootbits) {
+	unsigned blcount[MAX_BIT_LENGTH + 1];
 	unsigned nextcode[MAX_BIT_LENGTH + 1];
+	unsigned firstcode[MAX_BIT_LENGTH + 1];
+	unsigned char rootmaxlen[1 << HUFFMAN_ROOT_BITS];
+	const unsigned rootsize = 1u << rootbits;
+	unsigned used = rootsize;
 	unsigned bits, n, i;
-	unsigned nodefilled = 0; /*up to which node it is filled */
-	unsigned treepos = 0;	 /*position in the tree (1 of the numcodes columns) */
+	long left = 1;
 
-	/* initialize local vectors */
 	memset(blcount, 0, sizeof(blcount));
-	memset(nextcode, 0, sizeof(nextcode));
+	memset(rootmaxlen, 0, rootsize);
+	memset(table->entries, 0, rootsize * sizeof(uint32_t));
+	table->rootbits = rootbits;
 
-	/*step 1: count number of instances of each code length */
-	for (bits = 0; bits < tree->numcodes; bits++) {
-		blcount[bitlen[bits]]++;
+	/*step 1: count number of instances of each code length, more codes than fit the bit lengths can't be decoded */
+	for (n = 0; n < numcodes; n++) {
+		blcount[bitlen[n]]++;
+	}
+	for (bits = 1; bits <= MAX_BIT_LENGTH; bits++) {
+		left = (left << 1) - blcount[bits];
+		if (left < 0) {
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			return;
+		}
 	}
 
 	/*step 2: generate the nextcode values */
-	for (bits = 1; bits <= tree->maxbitlen; bits++) {
+	nextcode[0] = 0;
+	blcount[0] = 0;
+	for (bits = 1; bits <= MAX_BIT_LENGTH; bits++) {
 		nextcode[bits] = (nextcode[bits - 1] + blcount[bits - 1]) << 1;
 	}
 
-	/*step 3: generate all the codes */
-	for (n = 0; n < tree->numcodes; n++) {
-		if (bitlen[n] != 0) {
-			tree1d[n] = nextcode[bitlen[n]]++;
+	/*step 3: find how many extra bits the longest code behind each root entry needs and lay out the subtables */
+	memcpy(firstcode, nextcode, sizeof(firstcode));
+	for (n = 0; n < numcodes; n++) {
+		if (bitlen[n] > rootbits) {
+			const unsigned code = reverse_bits(firstcode[bitlen[n]]++, bitlen[n]) & (rootsize - 1);
+			if (bitlen[n] > rootmaxlen[code]) {
+				rootmaxlen[code] = (unsigned char)bitlen[n];
+			}
 		}
 	}
-
-	/*convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means uninited, a value >= numcodes is an address to another bit, a value < numcodes is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as many columns as codes - 1
-	   a good huffmann tree has N * 2 - 1 nodes, of which N - 1 are internal nodes. Here, the internal nodes are stored (what their 0 and 1 option point to). There is only memory for such good tree currently, if there are more nodes (due to too long length codes), error 55 will happen */
-	for (n = 0; n < tree->numcodes * 2; n++) {
-		tree->tree2d[n] = 32767; /*32767 here means the tree2d isn't filled there yet */
-	}
-
-	for (n = 0; n < tree->numcodes; n++) { /*the codes */
-		for (i = 0; i < bitlen[n]; i++) {  /*the bits for this code */
-			unsigned char bit = (unsigned char)((tree1d[n] >> (bitlen[n] - i - 1)) & 1);
-			/* check if oversubscribed */
-			if (treepos > tree->numcodes - 2) {
+	for (n = 0; n < rootsize; n++) {
+		if (rootmaxlen[n] != 0) {
+			const unsigned subbits = rootmaxlen[n] - rootbits;
+			if (used + (1u << subbits) > HUFFMAN_TABLE_SIZE) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				return;
 			}
-
-			if (tree->tree2d[2 * treepos + bit] == 32767) { /*not yet filled in */
-				if (i + 1 == bitlen[n]) {					/*last bit */
-					tree->tree2d[2 * treepos + bit] = n;	/*put the current code in it */
-					treepos = 0;
-				} else { /*put address of the next step in here, first that address has to be found of course (it's just nodefilled + 1)... */
-					nodefilled++;
-					tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes; /*addresses encoded with numcodes added to it */
-					treepos = nodefilled;
-				}
-			} else {
-				treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
-			}
+			table->entries[n] = HUFFMAN_LINK | (subbits << 16) | used;
+			memset(&table->entries[used], 0, (1u << subbits) * sizeof(uint32_t));
+			used += 1u << subbits;
 		}
 	}
 
-	for (n = 0; n < tree->numcodes * 2; n++) {
-		if (tree->tree2d[n] == 32767) {
-			tree->tree2d[n] = 0; /*remove possible remaining 32767's */
+	/*step 4: every code fills all entries whose low bits match it, the bits above it don't matter */
+	for (n = 0; n < numcodes; n++) {
+		const unsigned length = bitlen[n];
+		unsigned code;
+		if (length == 0) {
+			continue;
+		}
+		code = reverse_bits(nextcode[length]++, length);
+		if (length <= rootbits) {
+			for (i = code; i < rootsize; i += 1u << length) {
+				table->entries[i] = HUFFMAN_SYMBOL | (length << 16) | n;
+			}
+		} else {
+			const uint32_t link = table->entries[code & (rootsize - 1)];
+			const unsigned subsize = 1u << HUFFMAN_BITS(link);
+			for (i = code >> rootbits; i < subsize; i += 1u << (length - rootbits)) {
+				table->entries[HUFFMAN_VALUE(link) + i] = HUFFMAN_SYMBOL | (length << 16) | n;
+			}
 		}
 	}
 }
 
-static unsigned huffman_decode_symbol(upng_t* upng, const unsigned char* in, unsigned long* bp, const huffman_tree* codetree, unsigned long inlength) {
-	unsigned treepos = 0, ct;
-	unsigned char bit;
-	for (;;) {
-		/* error: end of input memory reached without endcode */
-		if (((*bp) & 0x07) == 0 && ((*bp) >> 3) > inlength) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return 0;
-		}
-
-		bit = read_bit(bp, in);
+static unsigned huffman_decode_symbol(upng_t* upng, bit_reader* bits, const huffman_table* table) {
+	uint32_t entry;
+	if (bits->count < MAX_BIT_LENGTH) {
+		bits_refill(bits);
+	}
 
-		ct = codetree->tree2d[(treepos << 1) | bit];
-		if (ct < codetree->numcodes) {
-			return ct;
-		}
+	entry = table->entries[bits->buffer & ((1u << table->rootbits) - 1)];
+	if (entry & HUFFMAN_LINK) {
+		entry = table->entries[HUFFMAN_VALUE(entry) + ((bits->buffer >> table->rootbits) & ((1u << HUFFMAN_BITS(entry)) - 1))];
+	}
 
-		treepos = ct - codetree->numcodes;
-		if (treepos >= codetree->numcodes) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return 0;
-		}
+	/* error: no such code, or end of input memory reached without endcode */
+	if ((entry & HUFFMAN_SYMBOL) == 0 || HUFFMAN_BITS(entry) > bits->count) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+		return 0;
 	}
+	bits_consume(bits, HUFFMAN_BITS(entry));
+	return HUFFMAN_VALUE(entry);
 }
 
 /* get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
-static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffman_tree* codetreeD, huffman_tree* codelengthcodetree, const unsigned char* in, unsigned long* bp, unsigned long inlength) {
+static void get_tree_inflate_dynamic(upng_t* upng, huffman_table* codetree, huffman_table* codetreeD, huffman_table* codelengthcodetree, bit_reader* bits) {
 	unsigned codelengthcode[NUM_CODE_LENGTH_CODES];
 	unsigned bitlen[NUM_DEFLATE_CODE_SYMBOLS];
 	unsigned bitlenD[NUM_DISTANCE_SYMBOLS];
 	unsigned n, hlit, hdist, hclen, i;
 
 	/*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated */
-	/*C-code note: use no "return" between ctor and dtor of an uivector! */
-	if ((*bp) >> 3 >= inlength - 2) {
-		SET_ERROR(upng, UPNG_EMALFORMED);
-		return;
-	}
-
-	/* clear bitlen arrays */
 	memset(bitlen, 0, sizeof(bitlen));
 	memset(bitlenD, 0, sizeof(bitlenD));
 
-	/*the bit pointer is or will go past the memory */
-	hlit = read_bits(bp, in, 5) + 257; /*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already */
-	hdist = read_bits(bp, in, 5) + 1;  /*number of distance codes. Unlike the spec, the value 1 is added to it here already */
-	hclen = read_bits(bp, in, 4) + 4;  /*number of code length codes. Unlike the spec, the value 4 is added to it here already */
+	hlit = bits_read(upng, bits, 5) + 257; /*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already */
+	hdist = bits_read(upng, bits, 5) + 1;  /*number of distance codes. Unlike the spec, the value 1 is added to it here already */
+	hclen = bits_read(upng, bits, 4) + 4;  /*number of code length codes. Unlike the spec, the value 4 is added to it here already */
 
 	for (i = 0; i < NUM_CODE_LENGTH_CODES; i++) {
 		if (i < hclen) {
-			codelengthcode[CLCL[i]] = read_bits(bp, in, 3);
+			codelengthcode[CLCL[i]] = bits_read(upng, bits, 3);
 		} else {
 			codelengthcode[CLCL[i]] = 0; /*if not, it must stay 0 */
 		}
 	}
 
-	huffman_tree_create_lengths(upng, codelengthcodetree, codelengthcode);
+	/* bail now if we ran out of input */
+	if (upng->error != UPNG_EOK) {
+		return;
+	}
+
+	huffman_table_create_lengths(upng, codelengthcodetree, codelengthcode, NUM_CODE_LENGTH_CODES, CODE_LENGTH_BITLEN);
 
 	/* bail now if we encountered an error earlier */
 	if (upng->error != UPNG_EOK) {
@@ -275,7 +330,8 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 	/*now we can use this tree to read the lengths for the tree that this function will return */
 	i = 0;
 	while (i < hlit + hdist) { /*i is the current symbol we're reading in the part that contains the code lengths of lit/len codes and dist codes */
-		unsigned code = huffman_decode_symbol(upng, in, bp, codelengthcodetree, inlength);
+		unsigned code = huffman_decode_symbol(upng, bits, codelengthcodetree);
+		unsigned replength, value;
 		if (upng->error != UPNG_EOK) {
 			break;
 		}
@@ -287,133 +343,101 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 				bitlenD[i - hlit] = code;
 			}
 			i++;
-		} else if (code == 16) {	/*repeat previous */
-			unsigned replength = 3; /*read in the 2 bits that indicate repeat length (3-6) */
-			unsigned value;			/*set value to the previous code */
+			continue;
+		}
 
-			if ((*bp) >> 3 >= inlength) {
+		if (code == 16) { /*repeat previous 3-6 times */
+			if (i == 0) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				break;
 			}
-			/*error, bit pointer jumps past memory */
-			replength += read_bits(bp, in, 2);
-
-			if ((i - 1) < hlit) {
-				value = bitlen[i - 1];
-			} else {
-				value = bitlenD[i - hlit - 1];
-			}
+			replength = 3 + bits_read(upng, bits, 2);
+			value = (i - 1) < hlit ? bitlen[i - 1] : bitlenD[i - hlit - 1];
+		} else if (code == 17) { /*repeat "0" 3-10 times */
+			replength = 3 + bits_read(upng, bits, 3);
+			value = 0;
+		} else if (code == 18) { /*repeat "0" 11-138 times */
+			replength = 11 + bits_read(upng, bits, 7);
+			value = 0;
+		} else {
+			/* somehow an unexisting code appeared. This can never happen. */
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			break;
+		}
 
-			/*repeat this value in the next lengths */
-			for (n = 0; n < replength; n++) {
-				/* i is larger than the amount of codes */
-				if (i >= hlit + hdist) {
-					SET_ERROR(upng, UPNG_EMALFORMED);
-					break;
-				}
+		/* error, bit pointer jumps past memory */
+		if (upng->error != UPNG_EOK) {
+			break;
+		}
 
-				if (i < hlit) {
-					bitlen[i] = value;
-				} else {
-					bitlenD[i - hlit] = value;
-				}
-				i++;
-			}
-		} else if (code == 17) {	/*repeat "0" 3-10 times */
-			unsigned replength = 3; /*read in the bits that indicate repeat length */
-			if ((*bp) >> 3 >= inlength) {
+		/*repeat this value in the next lengths */
+		for (n = 0; n < replength; n++) {
+			/* i is larger than the amount of codes */
+			if (i >= hlit + hdist) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				break;
 			}
 
-			/*error, bit pointer jumps past memory */
-			replength += read_bits(bp, in, 3);
-
-			/*repeat this value in the next lengths */
-			for (n = 0; n < replength; n++) {
-				/* error: i is larger than the amount of codes */
-				if (i >= hlit + hdist) {
-					SET_ERROR(upng, UPNG_EMALFORMED);
-					break;
-				}
-
-				if (i < hlit) {
-					bitlen[i] = 0;
-				} else {
-					bitlenD[i - hlit] = 0;
-				}
-				i++;
-			}
-		} else if (code == 18) {	 /*repeat "0" 11-138 times */
-			unsigned replength = 11; /*read in the bits that indicate repeat length */
-			/* error, bit pointer jumps past memory */
-			if ((*bp) >> 3 >= inlength) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				break;
-			}
-
-			replength += read_bits(bp, in, 7);
-
-			/*repeat this value in the next lengths */
-			for (n = 0; n < replength; n++) {
-				/* i is larger than the amount of codes */
-				if (i >= hlit + hdist) {
-					SET_ERROR(upng, UPNG_EMALFORMED);
-					break;
-				}
-				if (i < hlit)
-					bitlen[i] = 0;
-				else
-					bitlenD[i - hlit] = 0;
-				i++;
+			if (i < hlit) {
+				bitlen[i] = value;
+			} else {
+				bitlenD[i - hlit] = value;
 			}
-		} else {
-			/* somehow an unexisting code appeared. This can never happen. */
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			break;
+			i++;
 		}
 	}
 
+	/*the length of the end code 256 must be larger than 0 */
 	if (upng->error == UPNG_EOK && bitlen[256] == 0) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 	}
 
-	/*the length of the end code 256 must be larger than 0 */
 	/*now we've finally got hlit and hdist, so generate the code trees, and the function is done */
 	if (upng->error == UPNG_EOK) {
-		huffman_tree_create_lengths(upng, codetree, bitlen);
+		huffman_table_create_lengths(upng, codetree, bitlen, NUM_DEFLATE_CODE_SYMBOLS, HUFFMAN_ROOT_BITS);
 	}
 	if (upng->error == UPNG_EOK) {
-		huffman_tree_create_lengths(upng, codetreeD, bitlenD);
+		huffman_table_create_lengths(upng, codetreeD, bitlenD, NUM_DISTANCE_SYMBOLS, HUFFMAN_ROOT_BITS);
+	}
+}
+
+/* the fixed codes of btype 1 blocks, as code lengths */
+static void get_tree_inflate_fixed(upng_t* upng, huffman_table* codetree, huffman_table* codetreeD) {
+	unsigned bitlen[NUM_DEFLATE_CODE_SYMBOLS];
+	unsigned bitlenD[NUM_DISTANCE_SYMBOLS];
+	unsigned i;
+
+	for (i = 0; i < NUM_DEFLATE_CODE_SYMBOLS; i++) {
+		bitlen[i] = i <= 143 ? 8 : i <= 255 ? 9 : i <= 279 ? 7 : 8;
+	}
+	for (i = 0; i < NUM_DISTANCE_SYMBOLS; i++) {
+		bitlenD[i] = 5;
 	}
+
+	huffman_table_create_lengths(upng, codetree, bitlen, NUM_DEFLATE_CODE_SYMBOLS, HUFFMAN_ROOT_BITS);
+	huffman_table_create_lengths(upng, codetreeD, bitlenD, NUM_DISTANCE_SYMBOLS, HUFFMAN_ROOT_BITS);
 }
 
 /*inflate a block with dynamic of fixed Huffman tree*/
-static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char* in, unsigned long* bp, unsigned long* pos, unsigned long inlength, unsigned btype) {
-	unsigned codetree_buffer[DEFLATE_CODE_BUFFER_SIZE];
-	unsigned codetreeD_buffer[DISTANCE_BUFFER_SIZE];
+static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outsize, bit_reader* bits, unsigned long* pos, unsigned btype) {
+	huffman_table codetree;
+	huffman_table codetreeD;
 	unsigned done = 0;
 
-	huffman_tree codetree;
-	huffman_tree codetreeD;
-
 	if (btype == 1) {
 		/* fixed trees */
-		huffman_tree_init(&codetree, (unsigned*)FIXED_DEFLATE_CODE_TREE, NUM_DEFLATE_CODE_SYMBOLS, DEFLATE_CODE_BITLEN);
-		huffman_tree_init(&codetreeD, (unsigned*)FIXED_DISTANCE_TREE, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
+		get_tree_inflate_fixed(upng, &codetree, &codetreeD);
 	} else if (btype == 2) {
 		/* dynamic trees */
-		unsigned codelengthcodetree_buffer[CODE_LENGTH_BUFFER_SIZE];
-		huffman_tree codelengthcodetree;
-
-		huffman_tree_init(&codetree, codetree_buffer, NUM_DEFLATE_CODE_SYMBOLS, DEFLATE_CODE_BITLEN);
-		huffman_tree_init(&codetreeD, codetreeD_buffer, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
-		huffman_tree_init(&codelengthcodetree, codelengthcodetree_buffer, NUM_CODE_LENGTH_CODES, CODE_LENGTH_BITLEN);
-		get_tree_inflate_dynamic(upng, &codetree, &codetreeD, &codelengthcodetree, in, bp, inlength);
+		huffman_table codelengthcodetree;
+		get_tree_inflate_dynamic(upng, &codetree, &codetreeD, &codelengthcodetree, bits);
+	}
+	if (upng->error != UPNG_EOK) {
+		return;
 	}
 
 	while (done == 0) {
-		unsigned code = huffman_decode_symbol(upng, in, bp, &codetree, inlength);
+		unsigned code = huffman_decode_symbol(upng, bits, &codetree);
 		if (upng->error != UPNG_EOK) {
 			return;
 		}
@@ -433,21 +457,14 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 		} else if (code >= FIRST_LENGTH_CODE_INDEX && code <= LAST_LENGTH_CODE_INDEX) { /*length code */
 			/* part 1: get length base */
 			unsigned long length = LENGTH_BASE[code - FIRST_LENGTH_CODE_INDEX];
-			unsigned codeD, distance, numextrabitsD;
-			unsigned long start, forward, backward, numextrabits;
+			unsigned codeD, distance;
+			unsigned long start, forward, backward;
 
 			/* part 2: get extra bits and add the value of that to length */
-			numextrabits = LENGTH_EXTRA[code - FIRST_LENGTH_CODE_INDEX];
-
-			/* error, bit pointer will jump past memory */
-			if (((*bp) >> 3) >= inlength) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
-				return;
-			}
-			length += read_bits(bp, in, numextrabits);
+			length += bits_read(upng, bits, LENGTH_EXTRA[code - FIRST_LENGTH_CODE_INDEX]);
 
 			/*part 3: get distance code */
-			codeD = huffman_decode_symbol(upng, in, bp, &codetreeD, inlength);
+			codeD = huffman_decode_symbol(upng, bits, &codetreeD);
 			if (upng->error != UPNG_EOK) {
 				return;
 			}
@@ -458,24 +475,19 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 				return;
 			}
 
-			distance = DISTANCE_BASE[codeD];
-
 			/*part 4: get extra bits from distance */
-			numextrabitsD = DISTANCE_EXTRA[codeD];
+			distance = DISTANCE_BASE[codeD] + bits_read(upng, bits, DISTANCE_EXTRA[codeD]);
 
 			/* error, bit pointer will jump past memory */
-			if (((*bp) >> 3) >= inlength) {
-				SET_ERROR(upng, UPNG_EMALFORMED);
+			if (upng->error != UPNG_EOK) {
 				return;
 			}
 
-			distance += read_bits(bp, in, numextrabitsD);
-
 			/*part 5: fill in all the out[n] values based on the length and dist */
 			start = (*pos);
 			backward = start - distance;
 
-			if ((*pos) + length >= outsize) {
+			if ((*pos) + length >= outsize || distance > start) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				return;
 			}
@@ -488,22 +500,25 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 					backward = start - distance;
 				}
 			}
+		} else {
+			/* length codes 286-287 never occur */
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			return;
 		}
 	}
 }
 
-static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char* in, unsigned long* bp, unsigned long* pos, unsigned long inlength) {
+static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long outsize, bit_reader* bits, unsigned long* pos) {
+	const unsigned char* in = bits->in;
 	unsigned long p;
 	unsigned len, nlen, n;
 
 	/* go to first boundary of byte */
-	while (((*bp) & 0x7) != 0) {
-		(*bp)++;
-	}
-	p = (*bp) / 8; /*byte position */
+	bits_align_to_byte(bits);
+	p = bits->pos; /*byte position */
 
 	/* read len (2 bytes) and nlen (2 bytes) */
-	if (p >= inlength - 4) {
+	if (p + 4 > bits->size) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
@@ -525,7 +540,7 @@ static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long
 	}
 
 	/* read the literal data: len bytes are now stored in the out buffer */
-	if (p + len > inlength) {
+	if (p + len > bits->size) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
@@ -534,37 +549,34 @@ static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long
 		out[(*pos)++] = in[p++];
 	}
 
-	(*bp) = p * 8;
+	bits->pos = p;
 }
 
 /*inflate the deflated data (cfr. deflate spec); return value is the error*/
 static upng_error uz_inflate_data(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char* in, unsigned long insize, unsigned long inpos) {
-	unsigned long bp = 0;  /*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte) */
+	bit_reader bits;
 	unsigned long pos = 0; /*byte position in the out buffer */
 
 	unsigned done = 0;
 
+	bits_init(&bits, &in[inpos], insize - inpos);
 	while (done == 0) {
 		unsigned btype;
 
-		/* ensure next bit doesn't point past the end of the buffer */
-		if ((bp >> 3) >= insize) {
-			SET_ERROR(upng, UPNG_EMALFORMED);
-			return upng->error;
-		}
-
 		/* read block control bits */
-		done = read_bit(&bp, &in[inpos]);
-		btype = read_bit(&bp, &in[inpos]) | (read_bit(&bp, &in[inpos]) << 1);
+		done = bits_read(upng, &bits, 1);
+		btype = bits_read(upng, &bits, 2);
 
 		/* process control type appropriateyly */
-		if (btype == 3) {
+		if (upng->error != UPNG_EOK) {
+			return upng->error;
+		} else if (btype == 3) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
 			return upng->error;
 		} else if (btype == 0) {
-			inflate_uncompressed(upng, out, outsize, &in[inpos], &bp, &pos, insize); /*no compression */
+			inflate_uncompressed(upng, out, outsize, &bits, &pos); /*no compression */
 		} else {
-			inflate_huffman(upng, out, outsize, &in[inpos], &bp, &pos, insize, btype); /*compression, btype 01 or 10 */
+			inflate_huffman(upng, out, outsize, &bits, &pos, btype); /*compression, btype 01 or 10 */
 		}
 
 		/* stop if an error has occured */
@@ -622,6 +634,125 @@ static int paeth_predictor(int a, int b, int c) {
 		return c;
 }
 
+/* SSE2 versions of the byte-serial filters, working on a whole pixel at a time: the dependency on
+   the left pixel stays but each pixel's bytes are reconstructed in parallel. Only used for RGB and RGBA
+   with 8 bits per channel, the other formats keep the scalar loops. Paeth needs 16-bit absolute values, which
+   SSSE3 has as one instruction, so it is compiled twice and picked at runtime. */
+#if defined(__SSE2__)
+#define UPNG_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define UPNG_SSSE3
+#include <tmmintrin.h>
+#endif
+
+/* byte wise for RGB, a pixel never touches bytes past its own */
+static __m128i load_pixel(const unsigned char* p, unsigned long bytewidth) {
+	uint32_t v;
+	if (bytewidth == 4) {
+		memcpy(&v, p, 4);
+	} else {
+		v = p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+	}
+	return _mm_cvtsi32_si128((int)v);
+}
+
+static void store_pixel(unsigned char* p, __m128i pixel, unsigned long bytewidth) {
+	const uint32_t v = (uint32_t)_mm_cvtsi128_si32(pixel);
+	if (bytewidth == 4) {
+		memcpy(p, &v, 4);
+	} else {
+		p[0] = (unsigned char)v;
+		p[1] = (unsigned char)(v >> 8);
+		p[2] = (unsigned char)(v >> 16);
+	}
+}
+
+static void unfilter_sub_sse2(unsigned char* recon, const unsigned char* scanline, unsigned long bytewidth, unsigned long length) {
+	__m128i a = _mm_setzero_si128();
+	unsigned long i;
+	for (i = 0; i + bytewidth <= length; i += bytewidth) {
+		a = _mm_add_epi8(a, load_pixel(&scanline[i], bytewidth));
+		store_pixel(&recon[i], a, bytewidth);
+	}
+}
+
+/* Up has no dependency within the line, 16 bytes at a time. A scanline that shares memory with recon
+   starts at least one byte after it, so every store only lands on bytes that were already loaded */
+static void unfilter_up_sse2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, unsigned long length) {
+	unsigned long i;
+	for (i = 0; i + 16 <= length; i += 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+		const __m128i b = _mm_loadu_si128((const __m128i*)&precon[i]);
+		_mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(x, b));
+	}
+	for (; i < length; i++) recon[i] = scanline[i] + precon[i];
+}
+
+/* (a + b) / 2 without overflow: avg_epu8 rounds up, so take the lost low bit back off */
+static void unfilter_average_sse2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, unsigned long bytewidth, unsigned long length) {
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i a = _mm_setzero_si128();
+	unsigned long i;
+	for (i = 0; i + bytewidth <= length; i += bytewidth) {
+		const __m128i b = load_pixel(&precon[i], bytewidth);
+		const __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		a = _mm_add_epi8(load_pixel(&scanline[i], bytewidth), average);
+		store_pixel(&recon[i], a, bytewidth);
+	}
+}
+
+static __m128i abs_epi16_sse2(__m128i x) {
+	return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+/* in 16-bit lanes, with p = a + b - c: pa = |b - c|, pb = |a - c| and pc = |(b - c) + (a - c)|.
+   The predictor is the first of a, b, c whose distance is the smallest, like paeth_predictor */
+#define UNFILTER_PAETH_SSE(name, abs_epi16)                                                                                            \
+	static void name(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, unsigned long bytewidth, unsigned long length) { \
+		const __m128i zero = _mm_setzero_si128();                                                                                      \
+		__m128i a = zero, c = zero;                                                                                                    \
+		unsigned long i;                                                                                                               \
+		for (i = 0; i + bytewidth <= length; i += bytewidth) {                                                                         \
+			const __m128i b = _mm_unpacklo_epi8(load_pixel(&precon[i], bytewidth), zero);                                              \
+			const __m128i pa_signed = _mm_sub_epi16(b, c);                                                                             \
+			const __m128i pb_signed = _mm_sub_epi16(a, c);                                                                             \
+			const __m128i pa = abs_epi16(pa_signed);                                                                                   \
+			const __m128i pb = abs_epi16(pb_signed);                                                                                   \
+			const __m128i pc = abs_epi16(_mm_add_epi16(pa_signed, pb_signed));                                                         \
+			const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));                                                         \
+			const __m128i use_a = _mm_cmpeq_epi16(pa, smallest);                                                                       \
+			const __m128i use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(pb, smallest));                                              \
+			const __m128i use_c = _mm_andnot_si128(_mm_or_si128(use_a, use_b), _mm_set1_epi16(-1));                                   \
+			const __m128i predictor = _mm_or_si128(_mm_or_si128(_mm_and_si128(use_a, a), _mm_and_si128(use_b, b)), _mm_and_si128(use_c, c)); \
+			const __m128i pixel = _mm_add_epi8(load_pixel(&scanline[i], bytewidth), _mm_packus_epi16(predictor, predictor));           \
+			store_pixel(&recon[i], pixel, bytewidth);                                                                                  \
+			a = _mm_unpacklo_epi8(pixel, zero);                                                                                        \
+			c = b;                                                                                                                     \
+		}                                                                                                                              \
+	}
+
+UNFILTER_PAETH_SSE(unfilter_paeth_sse2, abs_epi16_sse2)
+
+#if defined(UPNG_SSSE3)
+__attribute__((target("ssse3"))) static __m128i abs_epi16_ssse3(__m128i x) {
+	return _mm_abs_epi16(x);
+}
+
+__attribute__((target("ssse3"))) UNFILTER_PAETH_SSE(unfilter_paeth_ssse3, abs_epi16_ssse3)
+#endif
+
+static void unfilter_paeth_simd(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, unsigned long bytewidth, unsigned long length) {
+#if defined(UPNG_SSSE3)
+	if (__builtin_cpu_supports("ssse3")) {
+		unfilter_paeth_ssse3(recon, scanline, precon, bytewidth, length);
+		return;
+	}
+#endif
+	unfilter_paeth_sse2(recon, scanline, precon, bytewidth, length);
+}
+#endif
+
 static void unfilter_scanline(upng_t* upng, unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, unsigned long bytewidth, unsigned char filterType, unsigned long length) {
 	/*
 	   For PNG filter method 0
@@ -632,6 +763,36 @@ static void unfilter_scanline(upng_t* upng, unsigned char* recon, const unsigned
 	 */
 
 	unsigned long i;
+#if defined(UPNG_SSE2)
+	const int simd = bytewidth == 3 || bytewidth == 4;
+	switch (filterType) {
+		case 1:
+			if (simd) {
+				unfilter_sub_sse2(recon, scanline, bytewidth, length);
+				return;
+			}
+			break;
+		case 2:
+			if (precon) {
+				unfilter_up_sse2(recon, scanline, precon, length);
+				return;
+			}
+			break;
+		case 3:
+			if (simd && precon) {
+				unfilter_average_sse2(recon, scanline, precon, bytewidth, length);
+				return;
+			}
+			break;
+		case 4:
+			if (simd && precon) {
+				unfilter_paeth_simd(recon, scanline, precon, bytewidth, length);
+				return;
+			}
+			break;
+	}
+#endif
+
 	switch (filterType) {
 		case 0:
 			for (i = 0; i < length; i++) recon[i] = scanline[i];
@@ -798,6 +959,16 @@ static upng_format determine_format(upng_t* upng) {
 	}
 }
 
+static void upng_free_buffer(upng_t* upng) {
+	if (upng->buffer_owning != 0) {
+		free(upng->buffer);
+	}
+
+	upng->buffer = NULL;
+	upng->size = 0;
+	upng->buffer_owning = 0;
+}
+
 static void upng_free_source(upng_t* upng) {
 	if (upng->source.owning != 0) {
 		free((void*)upng->source.buffer);
@@ -876,7 +1047,8 @@ upng_error upng_header(upng_t* upng) {
 }
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-upng_error upng_decode(upng_t* upng) {
+/*decodes into out, which must hold upng_get_output_size bytes, or into a buffer of our own when out is NULL*/
+static upng_error upng_decode_to(upng_t* upng, unsigned char* out) {
 	const unsigned char* chunk;
 	unsigned char* compressed;
 	unsigned char* inflated;
@@ -901,11 +1073,7 @@ upng_error upng_decode(upng_t* upng) {
 	}
 
 	/* release old result, if any */
-	if (upng->buffer != 0) {
-		free(upng->buffer);
-		upng->buffer = 0;
-		upng->size = 0;
-	}
+	upng_free_buffer(upng);
 
 	/* first byte of the first chunk after the header */
 	chunk = upng->source.buffer + 33;
@@ -995,12 +1163,18 @@ upng_error upng_decode(upng_t* upng) {
 	/* free the compressed compressed data */
 	free(compressed);
 
-	/* allocate final image buffer */
-	upng->size = (upng->height * upng->width * upng_get_bpp(upng) + 7) / 8;
-	upng->buffer = (unsigned char*)malloc(upng->size);
+	/* allocate final image buffer, unless the caller provided one */
+	upng->size = upng_get_output_size(upng);
+	if (out != NULL) {
+		upng->buffer = out;
+		upng->buffer_owning = 0;
+	} else {
+		upng->buffer = (unsigned char*)malloc(upng->size);
+		upng->buffer_owning = 1;
+	}
 	if (upng->buffer == NULL) {
 		free(inflated);
-		upng->size = 0;
+		upng_free_buffer(upng);
 		SET_ERROR(upng, UPNG_ENOMEM);
 		return upng->error;
 	}
@@ -1010,9 +1184,7 @@ upng_error upng_decode(upng_t* upng) {
 	free(inflated);
 
 	if (upng->error != UPNG_EOK) {
-		free(upng->buffer);
-		upng->buffer = NULL;
-		upng->size = 0;
+		upng_free_buffer(upng);
 	} else {
 		upng->state = UPNG_DECODED;
 	}
@@ -1023,6 +1195,23 @@ upng_error upng_decode(upng_t* upng) {
 	return upng->error;
 }
 
+upng_error upng_decode(upng_t* upng) { return upng_decode_to(upng, NULL); }
+
+upng_error upng_decode_into(upng_t* upng, unsigned char* buffer, unsigned long size) {
+	/* the header tells how large the image is */
+	upng_header(upng);
+	if (upng->error != UPNG_EOK) {
+		return upng->error;
+	}
+
+	if (buffer == NULL || size < upng_get_output_size(upng)) {
+		SET_ERROR(upng, UPNG_EPARAM);
+		return upng->error;
+	}
+
+	return upng_decode_to(upng, buffer);
+}
+
 static upng_t* upng_new(void) {
 	upng_t* upng;
 
@@ -1033,6 +1222,7 @@ static upng_t* upng_new(void) {
 
 	upng->buffer = NULL;
 	upng->size = 0;
+	upng->buffer_owning = 0;
 
 	upng->width = upng->height = 0;
 
@@ -1106,10 +1296,8 @@ upng_t* upng_new_from_file(const char* filename) {
 }
 
 void upng_free(upng_t* upng) {
-	/* deallocate image buffer */
-	if (upng->buffer != NULL) {
-		free(upng->buffer);
-	}
+	/* deallocate image buffer, if we own it */
+	upng_free_buffer(upng);
 
 	/* deallocate source buffer, if necessary */
 	upng_free_source(upng);
@@ -1155,4 +1343,6 @@ upng_format upng_get_format(const upng_t* upng) { return upng->format; }
 
 const unsigned char* upng_get_buffer(const upng_t* upng) { return upng->buffer; }
 
-unsigned upng_get_size(const upng_t* upng) { return upng->size; }
\ No newline at end of file
+unsigned upng_get_size(const upng_t* upng) { return upng->size; }
+
+unsigned long upng_get_output_size(const upng_t* upng) { return ((unsigned long)upng->height * upng->width * upng_get_bpp(upng) + 7) / 8; }
\ No newline at end of file
@@ -50,6 +50,9 @@ void upng_free(upng_t* upng);
 
 upng_error upng_header(upng_t* upng);
 upng_error upng_decode(upng_t* upng);
+/* decodes into buffer, which stays the caller's: it needs upng_get_output_size bytes and must
+   outlive any use of upng_get_buffer */
+upng_error upng_decode_into(upng_t* upng, unsigned char* buffer, unsigned long size);
 
 upng_error upng_get_error(const upng_t* upng);
 unsigned upng_get_error_line(const upng_t* upng);
@@ -64,5 +67,7 @@ upng_format upng_get_format(const upng_t* upng);
 
 const unsigned char* upng_get_buffer(const upng_t* upng);
 unsigned upng_get_size(const upng_t* upng);
+/* bytes of the decoded image, known once the header is read */
+unsigned long upng_get_output_size(const upng_t* upng);
 
 #endif /*defined(UPNG_H)*/
\ No newline at end of file
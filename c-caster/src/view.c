@@ -0,0 +1,20 @@
+#include "view.h"
+#include <stddef.h>
+#include "config.h"
+
+void getScreenView(view_t *view) {
+	view->camera = camera;
+	view->width = config.renderWidth;
+	view->height = config.renderHeight;
+	view->distProjPlane = config.distProjPlane;
+	view->pixels = getColorBuffer();
+	view->pitch = config.renderWidth;
+	view->rays = rays;
+	view->visibleSprites = NULL;
+	view->visibleCapacity = 0;
+	view->textures = NULL;
+	view->numTextures = 0;
+	view->usedTextures = NULL;
+	view->markSprites = false;
+	view->planes = (view_planes_t){NULL, NULL, NULL, NULL};
+}
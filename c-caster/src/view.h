@@ -0,0 +1,78 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "camera.h"
+#include "graphics.h"
+#include "ray.h"
+#include "sprite.h"
+#include "textures.h"
+
+// Optional planes rendered along with the pixels, each with one element per pixel at the same
+// pitch. NULL leaves a plane out, with no per-pixel cost.
+typedef struct view_planes_t {
+	float *depth;					// distance along the view direction in world units
+	uint16_t *depth16;				// the same in whole world units, saturating at UINT16_MAX
+	uint8_t *tileIds;				// map content of the wall seen, 0 on floor, ceiling and sprites
+	uint16_t *spriteIds;			// getViewSpriteId of the sprite seen, 0 where there is none
+} view_planes_t;
+
+// Everything a frame is rendered with: the pose, the resolution and where the rays and pixels
+// go. The game renders one view of the camera into the color buffer (see getScreenView),
+// observation batches render many small ones on the job workers (see observe.h).
+typedef struct view_t {
+	camera_t camera;
+	int width;
+	int height;
+	float distProjPlane;
+	color_t *pixels;
+	int pitch;						// pixels from one row to the next
+	ray_t *rays;					// one per column
+	sprite_t *visibleSprites;		// scratch for sorting the sprites in view
+	int visibleCapacity;			// fewer than every map sprite and entity leaves some out
+	// By handle plus one, so the placeholder comes first. NULL looks them up with getTexture,
+	// which only the render thread may do.
+	const texture_t **textures;
+	int numTextures;
+	uint8_t *usedTextures;			// set for every entry of textures drawn, NULL when not tracked
+	bool markSprites;				// sets the map sprites' visible flag for the mini-map
+	view_planes_t planes;
+} view_t;
+
+static inline const texture_t *getViewTexture(const view_t *view, texture_handle_t handle) {
+	if (view->textures == NULL) {
+		return getTexture(handle);
+	}
+	const int index = handle + 1 > 0 && handle + 1 < view->numTextures ? handle + 1 : 0;
+	if (view->usedTextures != NULL) {
+		view->usedTextures[index] = 1;
+	}
+	return view->textures[index];
+}
+
+static inline bool hasViewPlanes(const view_t *view) {
+	return view->planes.depth != NULL || view->planes.depth16 != NULL || view->planes.tileIds != NULL || view->planes.spriteIds != NULL;
+}
+
+// Map sprite i is i + 1, entity i follows the map sprites at getSpriteCount() + i + 1, both
+// saturating at UINT16_MAX
+static inline uint16_t getViewSpriteId(int index) {
+	return index < UINT16_MAX ? (uint16_t)(index + 1) : UINT16_MAX;
+}
+
+// Writes one pixel's depth to the planes that are on, sprites and walls share it
+static inline void setViewDepth(const view_t *view, size_t pixel, float depth) {
+	if (view->planes.depth != NULL) {
+		view->planes.depth[pixel] = depth;
+	}
+	if (view->planes.depth16 != NULL) {
+		view->planes.depth16[pixel] = depth < UINT16_MAX ? (uint16_t)depth : UINT16_MAX;
+	}
+}
+
+// The camera rendered into the color buffer at the configured resolution
+void getScreenView(view_t *view);
+
+#endif
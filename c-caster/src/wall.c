@@ -1,45 +1,88 @@
 
 
 #include "wall.h"
+#include "config.h"
 #include "graphics.h"
-#include "player.h"
+#include "camera.h"
+#include <limits.h>
 #include <math.h>
 #include "ray.h"
 #include "textures.h"
-#include "upng.h"
+#include "view.h"
 
+// The floor and ceiling are flat, half a tile below and above the camera: row y sees them as
+// far away as a wall whose bottom or top ends on y. Sprites are drawn later and clear their IDs.
+static void renderWallPlanes(const view_t *view, int x, float perpDistance, int wallTopY, int wallBottomY, uint8_t content) {
+	const int pitch = view->pitch;
+	const int height = view->height;
+	if (view->planes.depth != NULL || view->planes.depth16 != NULL) {
+		const float flatScale = (TILE_SIZE / 2) * view->distProjPlane;
+		const float horizon = (height >> 1) - 0.5f;
+		for (int y = 0; y < wallTopY; y++) {
+			setViewDepth(view, (size_t)y * pitch + x, flatScale / (horizon - y));
+		}
+		for (int y = wallTopY; y < wallBottomY; y++) {
+			setViewDepth(view, (size_t)y * pitch + x, perpDistance);
+		}
+		for (int y = wallBottomY; y < height; y++) {
+			setViewDepth(view, (size_t)y * pitch + x, flatScale / (y - horizon));
+		}
+	}
+	if (view->planes.tileIds != NULL) {
+		uint8_t *column = view->planes.tileIds + x;
+		for (int y = 0; y < height; y++) {
+			column[(size_t)y * pitch] = y >= wallTopY && y < wallBottomY ? content : 0;
+		}
+	}
+	if (view->planes.spriteIds != NULL) {
+		uint16_t *column = view->planes.spriteIds + x;
+		for (int y = 0; y < height; y++) {
+			column[(size_t)y * pitch] = 0;
+		}
+	}
+}
 
-void renderWallProjection(void) {
-	for (int x = 0; x < NUM_RAYS; x++) {
+void renderViewWalls(const view_t *view) {
+	const int renderHeight = view->height;
+	const ray_t *rays = view->rays;
+	const bool planes = hasViewPlanes(view);
+	for (int x = 0; x < view->width; x++) {
+		color_t *column = view->pixels + x;
 		// Calculate perpendicular distance to avoid fisheye effect
-		const float perpDistance = rays[x].distance * cosf(rays[x].rayAngle - player.rotationAngle);
+		const float perpDistance = rays[x].distance * cosf(rays[x].rayAngle - view->camera.angle);
 
 		// Calculate the projected wall height
-		const float wallHeight = (TILE_SIZE / perpDistance) * DIST_PROJ_PLANE;
-		const int halfHeight = (int) wallHeight >> 1;
+		const float wallHeight = (TILE_SIZE / perpDistance) * view->distProjPlane;
+		// A camera right on a wall sees it infinitely tall
+		const int halfHeight = wallHeight < INT_MAX ? (int) wallHeight >> 1 : INT_MAX >> 1;
 
 		// Find the wall top Y value
-		int wallTopY = (WINDOW_HEIGHT >> 1) - halfHeight;
+		int wallTopY = (renderHeight >> 1) - halfHeight;
 		if (wallTopY < 0) {
 			wallTopY = 0;
 		} else {
 			// Draw any ceiling in view
 			for (int y = 0; y < wallTopY; y++) {
-				drawPixel(x, y, 0xFF333333);
+				column[y * view->pitch] = 0xFF333333;
 			}
 		}
 
 		// Find the bottom Y value
-		int wallBottomY = (WINDOW_HEIGHT >> 1) + halfHeight;
-		if (wallBottomY > WINDOW_HEIGHT) {
-			wallBottomY = WINDOW_HEIGHT;
+		int wallBottomY = (renderHeight >> 1) + halfHeight;
+		if (wallBottomY > renderHeight) {
+			wallBottomY = renderHeight;
 		} else {
 			// Draw any floor in view
-			for (int y = wallBottomY; y < WINDOW_HEIGHT; y++) {
-				drawPixel(x, y, 0xFF777777);
+			for (int y = wallBottomY; y < renderHeight; y++) {
+				column[y * view->pitch] = 0xFF777777;
 			}
 		}
 
+		// Get the correct texture handle from the map content
+		const texture_t *texture = getViewTexture(view, rays[x].wallHitContent - 1);
+		int textureWidth = texture->width;
+		int textureHeight = texture->height;
+
 		int textureOffsetX;
 
 		// Calculaye texture offset x
@@ -50,28 +93,31 @@ void renderWallProjection(void) {
 			// Perform offset for the horisontal hit
 			textureOffsetX = (int) rays[x].wallHitX % TILE_SIZE;
 		}
-		
-		// Get the correct texture id number from the map content
-		uint8_t texNum = rays[x].wallHitContent - 1;
-		
-		// Query the width and height from the upng
-		upng_t *texture = textures[texNum];
-		int textureWidth = upng_get_width(texture);
-		int textureHeight = upng_get_height(texture);
+		// Scaled to the texture's own width, a reloaded or streamed PNG need not be TILE_SIZE wide
+		textureOffsetX = textureOffsetX * textureWidth / TILE_SIZE;
 
 		// Draw the vertical strip (e.g wall slice)
 		for (int y = wallTopY; y < wallBottomY; y++) {
 			// Calculate textureOffsetY, multiply by texture width / wallStrip height to translate texture to height of wall strip on the screen
-			int distanceFromTop = (y + halfHeight) - (WINDOW_HEIGHT >> 1);
+			int distanceFromTop = (y + halfHeight) - (renderHeight >> 1);
 			int textureOffsetY = distanceFromTop * ((float) textureHeight / wallHeight);
 
 			// set the color of the wall based on the color from the texture
-			color_t *wallTextureBuffer = (color_t*) upng_get_buffer(texture);
-			color_t texelColor = wallTextureBuffer[(textureWidth * textureOffsetY) + textureOffsetX];
+			color_t texelColor = getTexel(texture, (textureWidth * textureOffsetY) + textureOffsetX);
 			if(rays[x].wasHitVertical) {
 				changeColorIntensity(&texelColor, 0.7f);
 			}
-			drawPixel(x, y, texelColor);
+			column[y * view->pitch] = texelColor;
+		}
+
+		if (planes) {
+			renderWallPlanes(view, x, perpDistance, wallTopY, wallBottomY, rays[x].wallHitContent);
 		}
 	}
 }
+
+void renderWallProjection(void) {
+	view_t view;
+	getScreenView(&view);
+	renderViewWalls(&view);
+}
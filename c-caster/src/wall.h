@@ -1,6 +1,11 @@
 #ifndef WALL_H
 #define WALL_H
 
+struct view_t;
+
+// Ceiling, walls and floor of every column of the view, after castViewRays
+void renderViewWalls(const struct view_t *view);
+// renderViewWalls for the screen view
 void renderWallProjection(void);
 
 #endif
\ No newline at end of file
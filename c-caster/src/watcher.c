@@ -0,0 +1,201 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "watcher.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+
+#include <poll.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define MAX_WATCHED_DIRS 64
+#define MAX_CHANGED_FILES 64
+
+// Keyed by the prefix the caller registered, "maps/" and "./maps/" are watched as one directory
+// but each reports its changes under its own prefix
+typedef struct watched_dir_t {
+	int wd;
+	char prefix[MAX_WATCH_PATH];	// up to and including the last slash, empty for the working directory
+} watched_dir_t;
+
+static int inotifyFd = -1;
+static int wakeFds[2] = {-1, -1};	// written to on stop, so the thread never waits on a timeout
+static pthread_t watcherThread;
+static bool running = false;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static watched_dir_t dirs[MAX_WATCHED_DIRS];
+static int numDirs = 0;
+static char changedFiles[MAX_CHANGED_FILES][MAX_WATCH_PATH];
+static int numChanged = 0;
+
+static void addChangedFile(int wd, const char *name) {
+	pthread_mutex_lock(&lock);
+	for (int i = 0; i < numDirs; i++) {
+		if (dirs[i].wd != wd) {
+			continue;
+		}
+		char fileName[MAX_WATCH_PATH];
+		if (snprintf(fileName, sizeof(fileName), "%s%s", dirs[i].prefix, name) >= (int)sizeof(fileName)) {
+			continue;
+		}
+		bool known = false;
+		for (int j = 0; j < numChanged && !known; j++) {
+			known = strcmp(changedFiles[j], fileName) == 0;
+		}
+		if (!known && numChanged < MAX_CHANGED_FILES) {
+			strcpy(changedFiles[numChanged++], fileName);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+static void *watcherMain(void *arg) {
+	(void)arg;
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd fds[2] = {
+		{.fd = inotifyFd, .events = POLLIN},
+		{.fd = wakeFds[0], .events = POLLIN},
+	};
+
+	for (;;) {
+		if (poll(fds, 2, -1) < 0 || (fds[1].revents & POLLIN)) {
+			break;
+		}
+		const ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length;) {
+			const struct inotify_event *event = (const struct inotify_event *)(buffer + offset);
+			if (event->len > 0) {
+				addChangedFile(event->wd, event->name);
+			}
+			offset += sizeof(struct inotify_event) + event->len;
+		}
+	}
+	return NULL;
+}
+
+bool startFileWatcher(void) {
+	if (running) {
+		return true;
+	}
+	inotifyFd = inotify_init();
+	if (inotifyFd < 0 || pipe(wakeFds) != 0) {
+		fprintf(stderr, "Could not start watching files for changes\n");
+		stopFileWatcher();
+		return false;
+	}
+	if (pthread_create(&watcherThread, NULL, watcherMain, NULL) != 0) {
+		fprintf(stderr, "Could not start the file watcher thread\n");
+		stopFileWatcher();
+		return false;
+	}
+	running = true;
+	return true;
+}
+
+void stopFileWatcher(void) {
+	if (running) {
+		const char wake = 0;
+		if (write(wakeFds[1], &wake, 1) == 1) {
+			pthread_join(watcherThread, NULL);
+		}
+		running = false;
+	}
+	for (int i = 0; i < 2; i++) {
+		if (wakeFds[i] >= 0) {
+			close(wakeFds[i]);
+			wakeFds[i] = -1;
+		}
+	}
+	if (inotifyFd >= 0) {
+		close(inotifyFd);
+		inotifyFd = -1;
+	}
+	numDirs = 0;
+	numChanged = 0;
+}
+
+bool isFileWatcherRunning(void) {
+	return running;
+}
+
+bool watchFile(const char *fileName) {
+	if (!running) {
+		return false;
+	}
+	char prefix[MAX_WATCH_PATH];
+	char path[MAX_WATCH_PATH];
+	const char *slash = strrchr(fileName, '/');
+	const size_t length = slash != NULL ? (size_t)(slash - fileName) + 1 : 0;
+	if (length >= sizeof(prefix)) {
+		return false;
+	}
+	memcpy(prefix, fileName, length);
+	prefix[length] = '\0';
+	// The directory itself, without the trailing slash unless it is the root
+	strcpy(path, length == 0 ? "." : prefix);
+	if (length > 1) {
+		path[length - 1] = '\0';
+	}
+
+	pthread_mutex_lock(&lock);
+	bool watched = false;
+	for (int i = 0; i < numDirs && !watched; i++) {
+		watched = strcmp(dirs[i].prefix, prefix) == 0;
+	}
+	if (!watched && numDirs < MAX_WATCHED_DIRS) {
+		const int wd = inotify_add_watch(inotifyFd, path, IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd >= 0) {
+			dirs[numDirs].wd = wd;
+			strcpy(dirs[numDirs].prefix, prefix);
+			numDirs++;
+			watched = true;
+		} else {
+			fprintf(stderr, "Could not watch directory=%s for changes\n", path);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return watched;
+}
+
+bool nextChangedFile(char *fileName, size_t size) {
+	pthread_mutex_lock(&lock);
+	const bool changed = numChanged > 0;
+	if (changed) {
+		snprintf(fileName, size, "%s", changedFiles[0]);
+		memmove(changedFiles[0], changedFiles[1], (numChanged - 1) * sizeof(changedFiles[0]));
+		numChanged--;
+	}
+	pthread_mutex_unlock(&lock);
+	return changed;
+}
+
+#else
+
+bool startFileWatcher(void) {
+	fprintf(stderr, "Watching files for changes needs inotify, which this platform does not have\n");
+	return false;
+}
+
+void stopFileWatcher(void) {
+}
+
+bool isFileWatcherRunning(void) {
+	return false;
+}
+
+bool watchFile(const char *fileName) {
+	(void)fileName;
+	return false;
+}
+
+bool nextChangedFile(char *fileName, size_t size) {
+	(void)fileName;
+	(void)size;
+	return false;
+}
+
+#endif
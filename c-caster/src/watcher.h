@@ -0,0 +1,21 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Watches asset files for changes on a thread of its own (inotify, Linux only). A file counts as
+// changed once it is closed after writing or renamed into place, the way editors save.
+#define MAX_WATCH_PATH 256
+
+bool startFileWatcher(void);
+void stopFileWatcher(void);
+bool isFileWatcherRunning(void);
+
+// Watches the directory of fileName. Changed files are reported with the exact prefix fileName
+// has up to its last slash, so a name without one is reported as a bare name.
+bool watchFile(const char *fileName);
+// Pops the next changed file, each file is reported once however often it changed meanwhile
+bool nextChangedFile(char *fileName, size_t size);
+
+#endif
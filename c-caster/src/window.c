@@ -0,0 +1,110 @@
+#include "window.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "config.h"
+#include "defs.h"
+#include "graphics.h"
+
+static SDL_Window *window = NULL;
+static SDL_Renderer *renderer = NULL;
+static SDL_Texture *colorBufferTexture = NULL;
+
+// The texture only grows, changing the resolution within its size is free
+static int textureWidth = 0;
+static int textureHeight = 0;
+
+bool initializeWindow(void) {
+	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
+		fprintf(stderr, "Error initializing SDL\n");
+		return false;
+	}
+
+	SDL_DisplayMode displayMode;
+	SDL_GetCurrentDisplayMode(0, &displayMode);
+
+	int w = config.windowWidth > 0 ? config.windowWidth : displayMode.w;
+	int h = config.windowHeight > 0 ? config.windowHeight : displayMode.h;
+	if (config.fullScreen) {
+		w = displayMode.w;
+		h = displayMode.h;
+	}
+
+	window = SDL_CreateWindow(
+		"JayCaster", 
+		SDL_WINDOWPOS_CENTERED, 
+		SDL_WINDOWPOS_CENTERED, 
+		w, 
+		h, 
+		config.fullScreen ? SDL_WINDOW_BORDERLESS : SDL_WINDOW_RESIZABLE
+	);
+	if (!window) {
+		fprintf(stderr, "Error creating sdl window SDL\n");
+		return false;
+	}
+
+	renderer = SDL_CreateRenderer(window, SDL_DEFAULT_DRIVER, config.vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+	if (!renderer) {
+		fprintf(stderr, "Error creating sdl renderer SDL\n");
+		return false;
+	}
+
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	return true;
+}
+
+void getWindowSize(int *width, int *height) {
+	SDL_GetWindowSize(window, width, height);
+}
+
+// Grows the texture to hold the color buffer, keeps the old one when that fails
+static bool reserveColorBufferTexture(int width, int height) {
+	if (width <= textureWidth && height <= textureHeight) {
+		return true;
+	}
+	const int newWidth = width > textureWidth ? width : textureWidth;
+	const int newHeight = height > textureHeight ? height : textureHeight;
+	SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, newWidth, newHeight);
+	if (texture == NULL) {
+		fprintf(stderr, "Could not create a %dx%d texture to present\n", newWidth, newHeight);
+		return false;
+	}
+	SDL_DestroyTexture(colorBufferTexture);
+	colorBufferTexture = texture;
+	textureWidth = newWidth;
+	textureHeight = newHeight;
+	return true;
+}
+
+void renderColorBuffer(void) {
+	int bufferWidth, bufferHeight;
+	getColorBufferSize(&bufferWidth, &bufferHeight);
+	if (!reserveColorBufferTexture(bufferWidth, bufferHeight)) {
+		return;
+	}
+
+	// Only the top left part of the texture is in use when rendering below its size,
+	// that part gets stretched over the whole window
+	const SDL_Rect source = {0, 0, bufferWidth, bufferHeight};
+
+	// Pitch = the amount of bytes per row
+	SDL_UpdateTexture(
+        colorBufferTexture, 
+        &source, 
+        getColorBuffer(), 
+        (int) bufferWidth * sizeof(color_t)
+    );
+	SDL_RenderCopy(renderer, colorBufferTexture, &source, NULL);
+    SDL_RenderPresent(renderer);
+}
+
+void destroyWindow(void) {
+	SDL_DestroyTexture(colorBufferTexture);
+	SDL_DestroyRenderer(renderer);
+	SDL_DestroyWindow(window);
+	colorBufferTexture = NULL;
+	renderer = NULL;
+	window = NULL;
+	textureWidth = textureHeight = 0;
+	destroyColorBuffer();
+	SDL_Quit();
+}
@@ -0,0 +1,15 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include <stdbool.h>
+
+// The SDL window the game and the benchmark present the color buffer in. The rest of the engine
+// renders into memory and does not depend on SDL.
+bool initializeWindow(void);
+void getWindowSize(int *width, int *height);
+// Stretches the color buffer over the window and presents it
+void renderColorBuffer(void);
+// Also frees the color buffer
+void destroyWindow(void);
+
+#endif
@@ -0,0 +1,587 @@
+// Deterministic benchmark: replays scripted camera paths through the render stages
+// without frame caps and reports per-stage timings as JSON.
+//
+// Path files are plain text, one command per line ('#' starts a comment):
+//   start <x> <y> <angleDeg>         reset the player pose
+//   move  <frames> <walk> <turn>     hold walk/turn directions (-1, 0, 1) for a number of frames
+//   pose  <frames> <x> <y> <angleDeg> place the camera at a fixed pose for a number of frames
+//
+// Input logs recorded with `raycast --record FILE.input` are played as well, one simulation tick
+// per frame from the pose the recording began at, so a reported session can be benchmarked as is.
+//
+// Usage: raycast-bench [--warmup N] [--counters] [--resolution WxH]... [--fov DEG] [--observations N]
+//                      [--observation-size WxH] [--observation-planes] [--output file.json] path [path ...]
+// Every path is played at every --resolution (default: the configured render resolution).
+// The JSON goes to bench.json unless --output is given, stdout carries the engine's own logging.
+// The game's options apply as well, --guards N measures updateEntities with a crowd.
+// --observations N renders N frames of --observation-size WxH (default 128x96) every frame through
+// renderObservations, from the player's position turned evenly around the circle.
+// --observation-planes renders every depth and ID plane along with them.
+// --counters adds per-stage hardware counters (Linux perf events): averages per frame, IPC and
+// misses per ray or pixel. Reading them costs a syscall per stage, so compare timings only
+// between runs with the same setting.
+// Every change of walk/turn direction counts as an input arriving at the start of its frame, its
+// latency to the end of present is reported as input_latency. Each frame runs exactly one tick
+// here, so this is the pipeline's share of the latency, without waiting for frame or tick boundaries.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "camera.h"
+#include "config.h"
+#include "defs.h"
+#include "entity.h"
+#include "graphics.h"
+#include "input.h"
+#include "jobs.h"
+#include "latency.h"
+#include "map.h"
+#include "observe.h"
+#include "perfcounters.h"
+#include "player.h"
+#include "ray.h"
+#include "sprite.h"
+#include "textures.h"
+#include "timer.h"
+#include "utils.h"
+#include "wall.h"
+#include "window.h"
+
+// Every frame of a path file advances the simulation by exactly one nominal frame so runs are reproducible
+#define BENCH_DELTA_TIME (1.0f / FPS)
+#define BENCH_DEFAULT_WARMUP 30
+#define BENCH_DEFAULT_OUTPUT "bench.json"
+#define MAX_PATH_STEPS 1024
+#define MAX_RESOLUTIONS 16
+#define BENCH_OBSERVATION_WIDTH 128
+#define BENCH_OBSERVATION_HEIGHT 96
+
+typedef enum stage_t {
+	STAGE_MOVE_PLAYER,
+	STAGE_UPDATE_ENTITIES,
+	STAGE_OBSERVATIONS,
+	STAGE_CAST_ALL_RAYS,
+	STAGE_CLEAR,
+	STAGE_WALL_PROJECTION,
+	STAGE_SPRITE_PROJECTION,
+	STAGE_MINIMAP,
+	STAGE_PRESENT,
+	STAGE_FRAME,
+	NUM_STAGES
+} stage_t;
+
+static const char *stageNames[NUM_STAGES] = {
+	"movePlayer",
+	"updateEntities",
+	"renderObservations",
+	"castAllRays",
+	"clearColorBuffer",
+	"renderWallProjection",
+	"renderSpriteProjection",
+	"minimap",
+	"present",
+	"frame"
+};
+
+// What a stage's work scales with, used to normalize its counters
+typedef enum stage_unit_t { UNIT_NONE, UNIT_RAY, UNIT_PIXEL } stage_unit_t;
+
+static const stage_unit_t stageUnits[NUM_STAGES] = {
+	UNIT_NONE,
+	UNIT_NONE,
+	UNIT_NONE,
+	UNIT_RAY,
+	UNIT_PIXEL,
+	UNIT_PIXEL,
+	UNIT_PIXEL,
+	UNIT_NONE,
+	UNIT_PIXEL,
+	UNIT_NONE
+};
+
+typedef enum step_type_t { STEP_START, STEP_MOVE, STEP_POSE } step_type_t;
+
+typedef struct path_step_t {
+	step_type_t type;
+	int frames;
+	int walkDirection;
+	int turnDirection;
+	float x;
+	float y;
+	float angle;
+} path_step_t;
+
+typedef struct camera_path_t {
+	const char *name;
+	path_step_t steps[MAX_PATH_STEPS];
+	int numSteps;
+	int numFrames;
+	float deltaTime;
+} camera_path_t;
+
+static bool countersEnabled = false;
+
+// --observations: the cameras and the frames they are rendered into
+static int numObservations = 0;
+static int observationWidth = BENCH_OBSERVATION_WIDTH;
+static int observationHeight = BENCH_OBSERVATION_HEIGHT;
+static camera_t *observationCameras = NULL;
+static color_t *observationFrames = NULL;
+static bool observationPlanesEnabled = false;
+static view_planes_t observationPlanes = {NULL, NULL, NULL, NULL};
+
+// A start step at the recorded pose, then every run of identical tick inputs becomes a move step
+static bool loadInputPath(const char *fileName, camera_path_t *path) {
+	input_log_t log;
+	if (!loadInputLog(fileName, &log)) {
+		return false;
+	}
+	if (log.numRuns + 1 > MAX_PATH_STEPS) {
+		fprintf(stderr, "Too many input changes in log=%s\n", fileName);
+		freeInputLog(&log);
+		return false;
+	}
+
+	path->name = fileName;
+	path->numSteps = log.numRuns + 1;
+	path->numFrames = log.numTicks;
+	path->deltaTime = SIM_TICK_DELTA_TIME;
+	path->steps[0].type = STEP_START;
+	path->steps[0].frames = 0;
+	path->steps[0].x = log.startX;
+	path->steps[0].y = log.startY;
+	path->steps[0].angle = log.startAngle;
+	for (int i = 0; i < log.numRuns; i++) {
+		path_step_t *step = &path->steps[i + 1];
+		step->type = STEP_MOVE;
+		step->frames = log.runs[i].ticks;
+		step->walkDirection = log.runs[i].input.walkDirection;
+		step->turnDirection = log.runs[i].input.turnDirection;
+	}
+	freeInputLog(&log);
+	return true;
+}
+
+static bool loadCameraPath(const char *fileName, camera_path_t *path) {
+	const char *extension = strrchr(fileName, '.');
+	if (extension != NULL && strcmp(extension, ".input") == 0) {
+		return loadInputPath(fileName, path);
+	}
+
+	FILE *file = fopen(fileName, "r");
+	if (file == NULL) {
+		fprintf(stderr, "Could not open path=%s\n", fileName);
+		return false;
+	}
+
+	path->name = fileName;
+	path->numSteps = 0;
+	path->numFrames = 0;
+	path->deltaTime = BENCH_DELTA_TIME;
+
+	char line[256];
+	int lineNumber = 0;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		lineNumber++;
+		char *comment = strchr(line, '#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+
+		char command[16];
+		if (sscanf(line, "%15s", command) != 1) {
+			continue;
+		}
+		if (path->numSteps == MAX_PATH_STEPS) {
+			fprintf(stderr, "Too many steps in path=%s\n", fileName);
+			fclose(file);
+			return false;
+		}
+
+		path_step_t *step = &path->steps[path->numSteps];
+		float angleDeg = 0;
+		int parsed = 0;
+		if (strcmp(command, "start") == 0) {
+			step->type = STEP_START;
+			step->frames = 0;
+			parsed = sscanf(line, "%*s %f %f %f", &step->x, &step->y, &angleDeg) == 3;
+		} else if (strcmp(command, "move") == 0) {
+			step->type = STEP_MOVE;
+			parsed = sscanf(line, "%*s %d %d %d", &step->frames, &step->walkDirection, &step->turnDirection) == 3;
+		} else if (strcmp(command, "pose") == 0) {
+			step->type = STEP_POSE;
+			parsed = sscanf(line, "%*s %d %f %f %f", &step->frames, &step->x, &step->y, &angleDeg) == 4;
+		}
+		if (!parsed || step->frames < 0) {
+			fprintf(stderr, "Malformed line %d in path=%s\n", lineNumber, fileName);
+			fclose(file);
+			return false;
+		}
+
+		step->angle = DEG_TO_RAD(angleDeg);
+		path->numFrames += step->frames;
+		path->numSteps++;
+	}
+
+	fclose(file);
+	return true;
+}
+
+static void setPlayerPose(float x, float y, float angle) {
+	player.x = x;
+	player.y = y;
+	player.rotationAngle = angle;
+	player.walkDirection = 0;
+	player.turnDirection = 0;
+}
+
+static void renderMinimap(void) {
+	renderMapGrid();
+	renderMapRays();
+	renderMapPlayer();
+	renderMapSprites();
+	renderMapEntities();
+}
+
+static void renderPlayerObservations(void) {
+	for (int i = 0; i < numObservations; i++) {
+		observationCameras[i] = getPlayerPose();
+		observationCameras[i].angle += i * TWO_PI / numObservations;
+		normalizeAngle(&observationCameras[i].angle);
+	}
+	renderObservations(observationCameras, numObservations, observationWidth, observationHeight, observationFrames, &observationPlanes);
+}
+
+// Stage boundary k marks the start of stage k, the last one the end of the frame
+static void markStage(int boundary, uint64_t *t, perf_sample_t *c) {
+	if (countersEnabled) {
+		readPerfCounters(&c[boundary]);
+	}
+	t[boundary] = getTimestampNs();
+}
+
+// Runs one frame through every stage, stores the elapsed time of each in samples and,
+// when counterTotals is given, adds each stage's counter deltas to it
+static void runFrame(float deltaTime, uint64_t *samples, perf_sample_t *counterTotals) {
+	uint64_t t[NUM_STAGES];
+	perf_sample_t c[NUM_STAGES];
+
+	markStage(STAGE_MOVE_PLAYER, t, c);
+	markInputConsumed();
+	movePlayer(deltaTime);
+	setCameraToPlayer();
+	updateMapChunks(player.x, player.y);
+	markStage(STAGE_UPDATE_ENTITIES, t, c);
+	updateEntities(deltaTime);
+	markStage(STAGE_OBSERVATIONS, t, c);
+	renderPlayerObservations();
+	markStage(STAGE_CAST_ALL_RAYS, t, c);
+	castAllRays();
+	markStage(STAGE_CLEAR, t, c);
+	clearColorBuffer(0xFF000000);
+	markStage(STAGE_WALL_PROJECTION, t, c);
+	renderWallProjection();
+	markStage(STAGE_SPRITE_PROJECTION, t, c);
+	renderSpriteProjection();
+	markStage(STAGE_MINIMAP, t, c);
+	renderMinimap();
+	markStage(STAGE_PRESENT, t, c);
+	renderColorBuffer();
+	markStage(STAGE_FRAME, t, c);
+	markFramePresented(t[STAGE_FRAME]);
+
+	for (int stage = 0; stage < STAGE_FRAME; stage++) {
+		samples[stage] = t[stage + 1] - t[stage];
+	}
+	samples[STAGE_FRAME] = t[STAGE_FRAME] - t[STAGE_MOVE_PLAYER];
+
+	if (countersEnabled && counterTotals != NULL) {
+		for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+			for (int stage = 0; stage < STAGE_FRAME; stage++) {
+				counterTotals[stage].values[i] += c[stage + 1].values[i] - c[stage].values[i];
+			}
+			counterTotals[STAGE_FRAME].values[i] += c[STAGE_FRAME].values[i] - c[STAGE_MOVE_PLAYER].values[i];
+		}
+	}
+}
+
+// Plays the path once; when samples is NULL the frames are only used to warm caches
+static void playCameraPath(const camera_path_t *path, int maxFrames, uint64_t samples[][NUM_STAGES], perf_sample_t *counterTotals) {
+	uint64_t discarded[NUM_STAGES];
+	int frame = 0;
+
+	setPlayerPose(DEFAULT_RENDER_WIDTH >> 1, DEFAULT_RENDER_HEIGHT >> 1, PI / 2);
+	for (int i = 0; i < path->numSteps && frame < maxFrames; i++) {
+		const path_step_t *step = &path->steps[i];
+		if (step->type == STEP_START) {
+			setPlayerPose(step->x, step->y, step->angle);
+			continue;
+		}
+		for (int f = 0; f < step->frames && frame < maxFrames; f++, frame++) {
+			if (step->type == STEP_POSE) {
+				setPlayerPose(step->x, step->y, step->angle);
+			} else if (player.walkDirection != step->walkDirection || player.turnDirection != step->turnDirection) {
+				player.walkDirection = step->walkDirection;
+				player.turnDirection = step->turnDirection;
+				markInputEvent(getTimestampNs());
+			}
+			runFrame(path->deltaTime, samples != NULL ? samples[frame] : discarded, samples != NULL ? counterTotals : NULL);
+		}
+	}
+}
+
+static int compareSamples(const void *elem1, const void *elem2) {
+	const uint64_t a = *(const uint64_t *)elem1;
+	const uint64_t b = *(const uint64_t *)elem2;
+	return (a > b) - (a < b);
+}
+
+static void writeStageStats(FILE *out, uint64_t samples[][NUM_STAGES], int numFrames, int stage, uint64_t *scratch) {
+	for (int i = 0; i < numFrames; i++) {
+		scratch[i] = samples[i][stage];
+	}
+	qsort(scratch, numFrames, sizeof(uint64_t), compareSamples);
+
+	int p99Index = (numFrames * 99 + 99) / 100 - 1;
+	fprintf(
+		out,
+		"\"%s\": {\"min_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f",
+		stageNames[stage],
+		scratch[0] / 1e6,
+		scratch[numFrames / 2] / 1e6,
+		scratch[p99Index] / 1e6
+	);
+}
+
+// Counter averages per frame, plus IPC and misses per unit of work when the counters exist
+static void writeStageCounters(FILE *out, const perf_sample_t *totals, int numFrames, int stage) {
+	const uint64_t *values = totals->values;
+	fprintf(out, ", \"counters\": {");
+	for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+		if (isPerfCounterAvailable(i)) {
+			fprintf(out, "\"%s\": %.1f, ", perfCounterNames[i], (double)values[i] / numFrames);
+		}
+	}
+	if (isPerfCounterAvailable(PERF_CYCLES) && isPerfCounterAvailable(PERF_INSTRUCTIONS) && values[PERF_CYCLES] > 0) {
+		fprintf(out, "\"ipc\": %.3f, ", (double)values[PERF_INSTRUCTIONS] / values[PERF_CYCLES]);
+	}
+
+	const char *unitName = stageUnits[stage] == UNIT_RAY ? "ray" : "pixel";
+	const double unitsPerFrame = stageUnits[stage] == UNIT_RAY ? config.renderWidth : (double)config.renderWidth * config.renderHeight;
+	if (stageUnits[stage] != UNIT_NONE) {
+		for (int i = PERF_L1D_MISSES; i < NUM_PERF_COUNTERS; i++) {
+			if (isPerfCounterAvailable(i)) {
+				fprintf(out, "\"%s_per_%s\": %.5f, ", perfCounterNames[i], unitName, values[i] / (unitsPerFrame * numFrames));
+			}
+		}
+	}
+	fprintf(out, "\"frames\": %d}", numFrames);
+}
+
+static void writePathResult(FILE *out, const camera_path_t *path, uint64_t samples[][NUM_STAGES], const perf_sample_t *counterTotals, uint64_t *scratch) {
+	fprintf(
+		out,
+		"    {\"path\": \"%s\", \"width\": %d, \"height\": %d, \"rays\": %d, \"frames\": %d, \"stages\": {\n",
+		path->name,
+		config.renderWidth,
+		config.renderHeight,
+		config.renderWidth,
+		path->numFrames
+	);
+	for (int stage = 0; stage < NUM_STAGES; stage++) {
+		fprintf(out, "      ");
+		writeStageStats(out, samples, path->numFrames, stage, scratch);
+		if (countersEnabled) {
+			writeStageCounters(out, &counterTotals[stage], path->numFrames, stage);
+		}
+		fprintf(out, "}");
+		fprintf(out, stage + 1 < NUM_STAGES ? ",\n" : "\n");
+	}
+	fprintf(out, "    }");
+
+	latency_stats_t latency;
+	if (getInputLatencyStats(&latency)) {
+		fprintf(out, ", \"input_latency\": {\"inputs\": %d, \"mean_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}", latency.count, latency.meanMs, latency.p99Ms, latency.maxMs);
+	}
+	fprintf(out, "}");
+}
+
+static void printUsage(void) {
+	fprintf(stderr, "Usage: raycast-bench [--warmup N] [--counters] [--resolution WxH]... [--fov DEG] [--observations N] [--observation-size WxH] [--observation-planes] [--output file.json] path [path ...]\n");
+}
+
+int main(int argc, char *argv[]) {
+	int warmupFrames = BENCH_DEFAULT_WARMUP;
+	const char *outputFileName = BENCH_DEFAULT_OUTPUT;
+	int firstPath = argc;
+	int widths[MAX_RESOLUTIONS];
+	int heights[MAX_RESOLUTIONS];
+	int numResolutions = 0;
+
+	for (int i = 1; i < argc; i++) {
+		const int consumed = parseConfigOption(argc, argv, i);
+		if (consumed > 0) {
+			i += consumed - 1;
+		} else if (consumed < 0) {
+			return EXIT_FAILURE;
+		} else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+			if (numResolutions == MAX_RESOLUTIONS || sscanf(argv[++i], "%dx%d", &widths[numResolutions], &heights[numResolutions]) != 2) {
+				printUsage();
+				return EXIT_FAILURE;
+			}
+			numResolutions++;
+		} else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			warmupFrames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--counters") == 0) {
+			countersEnabled = true;
+		} else if (strcmp(argv[i], "--observations") == 0 && i + 1 < argc) {
+			numObservations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--observation-size") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &observationWidth, &observationHeight) != 2 || observationWidth <= 0 || observationHeight <= 0) {
+				printUsage();
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--observation-planes") == 0) {
+			observationPlanesEnabled = true;
+		} else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			outputFileName = argv[++i];
+		} else if (argv[i][0] == '-') {
+			printUsage();
+			return EXIT_FAILURE;
+		} else {
+			firstPath = i;
+			break;
+		}
+	}
+	if (firstPath == argc) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+	if (numResolutions == 0) {
+		widths[0] = config.renderWidth;
+		heights[0] = config.renderHeight;
+		numResolutions = 1;
+	}
+
+	const int numPaths = argc - firstPath;
+	camera_path_t *paths = malloc(numPaths * sizeof(camera_path_t));
+	int maxFrames = 0;
+	for (int i = 0; i < numPaths; i++) {
+		if (!loadCameraPath(argv[firstPath + i], &paths[i])) {
+			free(paths);
+			return EXIT_FAILURE;
+		}
+		if (paths[i].numFrames == 0) {
+			fprintf(stderr, "No frames in path=%s\n", paths[i].name);
+			free(paths);
+			return EXIT_FAILURE;
+		}
+		if (paths[i].numFrames > maxFrames) {
+			maxFrames = paths[i].numFrames;
+		}
+	}
+
+	// A plain window at the first resolution, present stretches every other one onto it
+	config.fullScreen = false;
+	config.vsync = false;
+	config.windowWidth = widths[0];
+	config.windowHeight = heights[0];
+	if (!initializeWindow()) {
+		free(paths);
+		return EXIT_FAILURE;
+	}
+	startJobWorkers(config.threads);
+	const uint64_t loadStart = getTimestampNs();
+	if (!loadTextures() || !preloadTextures() || !loadMap(config.mapFile, false) || !createSprites() || !spawnGuards(config.guards, GUARD_SEED)) {
+		freeEntities();
+		freeSprites();
+		freeMap();
+		freeTextures();
+		stopJobWorkers();
+		destroyWindow();
+		free(paths);
+		return EXIT_FAILURE;
+	}
+	const double textureLoadMs = (getTimestampNs() - loadStart) / 1e6;
+
+	// Only once everything is up, so a failed start leaves no empty output behind
+	FILE *out = fopen(outputFileName, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Could not open output=%s\n", outputFileName);
+		freeEntities();
+		freeSprites();
+		freeMap();
+		freeTextures();
+		stopJobWorkers();
+		destroyWindow();
+		free(paths);
+		return EXIT_FAILURE;
+	}
+
+	if (countersEnabled && !openPerfCounters()) {
+		fprintf(stderr, "Perf counters not permitted or not supported, reporting timings only\n");
+		countersEnabled = false;
+	}
+
+	if (numObservations > 0) {
+		observationCameras = malloc(numObservations * sizeof(camera_t));
+		const size_t pixels = (size_t)numObservations * observationWidth * observationHeight;
+		observationFrames = malloc(pixels * sizeof(color_t));
+		if (observationPlanesEnabled) {
+			observationPlanes.depth = malloc(pixels * sizeof(float));
+			observationPlanes.depth16 = malloc(pixels * sizeof(uint16_t));
+			observationPlanes.tileIds = malloc(pixels * sizeof(uint8_t));
+			observationPlanes.spriteIds = malloc(pixels * sizeof(uint16_t));
+		}
+		if (observationCameras == NULL || observationFrames == NULL || (observationPlanesEnabled && (observationPlanes.depth == NULL
+			|| observationPlanes.depth16 == NULL || observationPlanes.tileIds == NULL || observationPlanes.spriteIds == NULL))) {
+			fprintf(stderr, "Out of memory for %d observations, skipping them\n", numObservations);
+			numObservations = 0;
+		}
+	}
+
+	uint64_t (*samples)[NUM_STAGES] = malloc(maxFrames * sizeof(*samples));
+	uint64_t *scratch = malloc(maxFrames * sizeof(uint64_t));
+
+	fprintf(out, "{\n  \"fov\": %.2f, \"warmup\": %d, \"counters\": %s, \"threads\": %d, \"texture_load_ms\": %.3f,\n", config.fov * 180 / PI, warmupFrames, countersEnabled ? "true" : "false", getJobThreadCount(), textureLoadMs);
+	fprintf(out, "  \"observations\": %d, \"observation_width\": %d, \"observation_height\": %d, \"observation_planes\": %s,\n", numObservations, observationWidth, observationHeight, observationPlanesEnabled ? "true" : "false");
+	fprintf(out, "  \"results\": [\n");
+	for (int r = 0; r < numResolutions; r++) {
+		if (!setRenderResolution(widths[r], heights[r])) {
+			fprintf(stderr, "Skipping invalid resolution %dx%d\n", widths[r], heights[r]);
+			continue;
+		}
+		for (int i = 0; i < numPaths; i++) {
+			perf_sample_t counterTotals[NUM_STAGES];
+			memset(counterTotals, 0, sizeof(counterTotals));
+			playCameraPath(&paths[i], warmupFrames, NULL, NULL);
+			resetInputLatency();
+			playCameraPath(&paths[i], paths[i].numFrames, samples, counterTotals);
+			writePathResult(out, &paths[i], samples, counterTotals, scratch);
+			fprintf(out, r + 1 < numResolutions || i + 1 < numPaths ? ",\n" : "\n");
+		}
+	}
+	fprintf(out, "  ]\n}\n");
+
+	fclose(out);
+	printf("Benchmark results written to %s\n", outputFileName);
+	free(scratch);
+	free(samples);
+	free(paths);
+	free(observationCameras);
+	free(observationFrames);
+	free(observationPlanes.depth);
+	free(observationPlanes.depth16);
+	free(observationPlanes.tileIds);
+	free(observationPlanes.spriteIds);
+	closePerfCounters();
+	freeObservations();
+	freeEntities();
+	freeSprites();
+	freeMap();
+	freeTextures();
+	freeRays();
+	stopJobWorkers();
+	destroyWindow();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,380 @@
+// Golden-image regression check: renders fixed camera poses on the shipped map into memory
+// and compares them against reference images recorded from a known-good build. The references
+// are committed in golden/, so a check guards every commit; record them again only for changes
+// that are meant to move pixels.
+//
+// Frames are rendered at GOLDEN_WIDTH x GOLDEN_HEIGHT, small enough to keep the references small,
+// at the default field of view and without the mini-map, which would cover most of them.
+//
+// Usage:
+//   raycast-golden record <dir>
+//   raycast-golden check <dir> [--profile exact|bounded] [--tolerance N] [--max-pixels F] [--diff-dir dir]
+//
+// Images are binary PPM files named after the pose. A pixel differs when any channel is off by
+// more than the tolerance, a pose passes when at most max-pixels (a fraction) of its pixels differ.
+// Every pose is checked with the profile of its render path, --profile applies one to all of them
+// and --tolerance / --max-pixels override single values.
+//
+// A check also renders every pose through the other view paths, renderObservations and the
+// library's raycastRender*, with the depth and ID planes on. Their frames must match the screen's
+// bit for bit, and the planes must hold the pose's probe: the depth, tile ID and sprite ID of one
+// known pixel.
+// For every pose with differences a <pose>.diff.ppm is written: red where the tolerance is exceeded,
+// gray where pixels differ within the tolerance.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "camera.h"
+#include "config.h"
+#include "defs.h"
+#include "graphics.h"
+#include "jobs.h"
+#include "map.h"
+#include "observe.h"
+#include "player.h"
+#include "ray.h"
+#include "raycast.h"
+#include "sprite.h"
+#include "textures.h"
+#include "wall.h"
+
+#define MAX_FILE_NAME 512
+#define GOLDEN_WIDTH 320
+#define GOLDEN_HEIGHT 200
+
+// What the planes must hold at one pixel of a pose
+typedef struct golden_probe_t {
+	int x;
+	int y;
+	float depth;
+	uint8_t tileId;
+	uint16_t spriteId;
+} golden_probe_t;
+
+typedef struct golden_pose_t {
+	const char *name;
+	float x;
+	float y;
+	float angleDeg;
+	const char *profile;
+	golden_probe_t probe;
+} golden_pose_t;
+
+// The frames and planes of the other view paths, width x height each
+typedef struct view_frames_t {
+	color_t *observation;
+	color_t *library;
+	color_t *batch;
+	raycast_planes_t libraryPlanes;
+	raycast_planes_t batchPlanes;
+} view_frames_t;
+
+// Exact: paths that must match bit for bit (DDA stepping, SIMD). Bounded: paths allowed
+// to drift slightly (fixed-point stepping, filtered or mipmapped sampling).
+typedef struct tolerance_profile_t {
+	const char *name;
+	int tolerance;
+	float maxPixels;
+} tolerance_profile_t;
+
+// Rays that run along walls for long stretches hit on rounding, so the poses made of them may
+// move a few pixels between compilers. The probes cover sprites, walls and the floor.
+static const golden_pose_t poses[] = {
+	{"start", 640, 400, 90, "exact", {150, 100, 230.00f, 0, 1}},
+	{"spawn-north", 640, 400, 270, "exact", {40, 100, 80.00f, 4, 0}},
+	{"corner", 90, 90, 45, "exact", {210, 100, 367.70f, 0, 3}},
+	{"wall-closeup", 200, 700, 270, "exact", {250, 100, 300.00f, 0, 3}},
+	{"pillars", 470, 330, 0, "exact", {40, 100, 23.09f, 3, 0}},
+	{"sprites", 700, 700, 180, "exact", {160, 190, 97.99f, 0, 0}},
+	{"long-view", 1150, 700, 200, "bounded", {160, 100, 338.41f, 1, 0}},
+	{"grazing", 100, 400, 89, "bounded", {40, 100, 370.86f, 1, 0}},
+};
+
+static const tolerance_profile_t profiles[] = {
+	{"exact", 0, 0.0f},
+	{"bounded", 8, 0.001f},
+};
+
+#define NUM_POSES (sizeof(poses) / sizeof(poses[0]))
+#define NUM_PROFILES (sizeof(profiles) / sizeof(profiles[0]))
+
+static void renderPose(const golden_pose_t *pose) {
+	player.x = pose->x;
+	player.y = pose->y;
+	player.rotationAngle = DEG_TO_RAD(pose->angleDeg);
+	player.walkDirection = 0;
+	player.turnDirection = 0;
+	setCameraToPlayer();
+	preloadMapChunks(player.x, player.y);
+
+	castAllRays();
+	clearColorBuffer(0xFF000000);
+	renderWallProjection();
+	renderSpriteProjection();
+}
+
+static bool allocateViewFrames(view_frames_t *frames) {
+	const size_t count = (size_t)GOLDEN_WIDTH * GOLDEN_HEIGHT;
+	frames->observation = malloc(count * sizeof(color_t));
+	frames->library = malloc(count * sizeof(color_t));
+	frames->batch = malloc(count * sizeof(color_t));
+	raycast_planes_t *planes[2] = {&frames->libraryPlanes, &frames->batchPlanes};
+	bool allocated = frames->observation != NULL && frames->library != NULL && frames->batch != NULL;
+	for (int i = 0; i < 2; i++) {
+		planes[i]->depth = malloc(count * sizeof(float));
+		planes[i]->depth16 = malloc(count * sizeof(uint16_t));
+		planes[i]->tileIds = malloc(count * sizeof(uint8_t));
+		planes[i]->spriteIds = malloc(count * sizeof(uint16_t));
+		allocated = allocated && planes[i]->depth != NULL && planes[i]->depth16 != NULL && planes[i]->tileIds != NULL && planes[i]->spriteIds != NULL;
+	}
+	return allocated;
+}
+
+static void freeViewFrames(view_frames_t *frames) {
+	free(frames->observation);
+	free(frames->library);
+	free(frames->batch);
+	raycast_planes_t *planes[2] = {&frames->libraryPlanes, &frames->batchPlanes};
+	for (int i = 0; i < 2; i++) {
+		free(planes[i]->depth);
+		free(planes[i]->depth16);
+		free(planes[i]->tileIds);
+		free(planes[i]->spriteIds);
+	}
+}
+
+static bool arePlanesEqual(const raycast_planes_t *a, const raycast_planes_t *b) {
+	const size_t count = (size_t)GOLDEN_WIDTH * GOLDEN_HEIGHT;
+	return memcmp(a->depth, b->depth, count * sizeof(float)) == 0 && memcmp(a->depth16, b->depth16, count * sizeof(uint16_t)) == 0
+		&& memcmp(a->tileIds, b->tileIds, count * sizeof(uint8_t)) == 0 && memcmp(a->spriteIds, b->spriteIds, count * sizeof(uint16_t)) == 0;
+}
+
+// Renders the camera of the pose just rendered to the screen through the other view paths and
+// compares them with the color buffer
+static bool checkViews(raycast_engine_t *engine, const golden_pose_t *pose, view_frames_t *frames) {
+	const size_t frameSize = (size_t)GOLDEN_WIDTH * GOLDEN_HEIGHT * sizeof(color_t);
+	const raycast_pose_t libraryPose = {camera.x, camera.y, camera.angle};
+	const bool rendered = renderObservations(&camera, 1, GOLDEN_WIDTH, GOLDEN_HEIGHT, frames->observation, NULL)
+		&& raycastRenderPlanes(engine, &libraryPose, frames->library, GOLDEN_WIDTH, GOLDEN_HEIGHT, GOLDEN_WIDTH * sizeof(color_t), &frames->libraryPlanes)
+		&& raycastRenderBatchPlanes(engine, &libraryPose, 1, frames->batch, GOLDEN_WIDTH, GOLDEN_HEIGHT, &frames->batchPlanes);
+	const color_t *screen = getColorBuffer();
+	const bool observationOk = rendered && memcmp(frames->observation, screen, frameSize) == 0;
+	const bool libraryOk = rendered && memcmp(frames->library, screen, frameSize) == 0 && memcmp(frames->batch, screen, frameSize) == 0
+		&& arePlanesEqual(&frames->libraryPlanes, &frames->batchPlanes);
+
+	const golden_probe_t *probe = &pose->probe;
+	const size_t pixel = (size_t)probe->y * GOLDEN_WIDTH + probe->x;
+	const float depth = frames->libraryPlanes.depth[pixel];
+	const uint8_t tileId = frames->libraryPlanes.tileIds[pixel];
+	const uint16_t spriteId = frames->libraryPlanes.spriteIds[pixel];
+	const bool probeOk = rendered && fabsf(depth - probe->depth) <= 0.01f && frames->libraryPlanes.depth16[pixel] == (uint16_t)depth
+		&& tileId == probe->tileId && spriteId == probe->spriteId;
+
+	const bool passed = observationOk && libraryOk && probeOk;
+	printf("%-14s %s  views: observation %s, library %s, probe %d,%d depth %.2f tile %d sprite %d%s\n", pose->name, passed ? "ok  " : "FAIL",
+		observationOk ? "same" : "DIFFERS", libraryOk ? "same" : "DIFFERS", probe->x, probe->y, depth, tileId, spriteId,
+		probeOk ? "" : " (unexpected)");
+	return passed;
+}
+
+// color_t is RGBA32, i.e the bytes in memory are R, G, B, A
+static void colorToRgb(color_t color, unsigned char *rgb) {
+	rgb[0] = color & 0xFF;
+	rgb[1] = (color >> 8) & 0xFF;
+	rgb[2] = (color >> 16) & 0xFF;
+}
+
+static bool writePpm(const char *fileName, const unsigned char *rgb, int width, int height) {
+	FILE *file = fopen(fileName, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not write image=%s\n", fileName);
+		return false;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	const size_t size = (size_t)width * height * 3;
+	const bool written = fwrite(rgb, 1, size, file) == size;
+	fclose(file);
+	return written;
+}
+
+static bool readPpm(const char *fileName, unsigned char *rgb, int width, int height) {
+	FILE *file = fopen(fileName, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Missing reference image=%s\n", fileName);
+		return false;
+	}
+	int fileWidth, fileHeight, maxValue;
+	if (fscanf(file, "P6 %d %d %d", &fileWidth, &fileHeight, &maxValue) != 3 || fgetc(file) == EOF) {
+		fprintf(stderr, "Malformed reference image=%s\n", fileName);
+		fclose(file);
+		return false;
+	}
+	if (fileWidth != width || fileHeight != height || maxValue != 255) {
+		fprintf(stderr, "Reference image=%s is %dx%d, expected %dx%d\n", fileName, fileWidth, fileHeight, width, height);
+		fclose(file);
+		return false;
+	}
+	const size_t size = (size_t)width * height * 3;
+	const bool read = fread(rgb, 1, size, file) == size;
+	fclose(file);
+	return read;
+}
+
+static void captureColorBuffer(unsigned char *rgb) {
+	const color_t *colorBuffer = getColorBuffer();
+	for (int i = 0; i < GOLDEN_WIDTH * GOLDEN_HEIGHT; i++) {
+		colorToRgb(colorBuffer[i], &rgb[i * 3]);
+	}
+}
+
+// Returns the number of pixels exceeding the tolerance and fills the diff image
+static int compareImages(const unsigned char *actual, const unsigned char *expected, unsigned char *diff, int tolerance, int *maxDelta) {
+	int failedPixels = 0;
+	*maxDelta = 0;
+	for (int i = 0; i < GOLDEN_WIDTH * GOLDEN_HEIGHT; i++) {
+		int delta = 0;
+		for (int c = 0; c < 3; c++) {
+			const int d = abs(actual[i * 3 + c] - expected[i * 3 + c]);
+			if (d > delta) {
+				delta = d;
+			}
+		}
+		if (delta > *maxDelta) {
+			*maxDelta = delta;
+		}
+
+		unsigned char *out = &diff[i * 3];
+		if (delta > tolerance) {
+			failedPixels++;
+			out[0] = 128 + delta / 2;
+			out[1] = 0;
+			out[2] = 0;
+		} else {
+			out[0] = out[1] = out[2] = delta > 0 ? 64 : 0;
+		}
+	}
+	return failedPixels;
+}
+
+static const tolerance_profile_t *findProfile(const char *name) {
+	for (size_t i = 0; i < NUM_PROFILES; i++) {
+		if (strcmp(profiles[i].name, name) == 0) {
+			return &profiles[i];
+		}
+	}
+	return NULL;
+}
+
+static void printUsage(void) {
+	fprintf(stderr, "Usage: raycast-golden record <dir>\n");
+	fprintf(stderr, "       raycast-golden check <dir> [--profile exact|bounded] [--tolerance N] [--max-pixels F] [--diff-dir dir]\n");
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 3 || (strcmp(argv[1], "record") != 0 && strcmp(argv[1], "check") != 0)) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+	const bool record = strcmp(argv[1], "record") == 0;
+	const char *referenceDir = argv[2];
+	const char *diffDir = referenceDir;
+	const tolerance_profile_t *forcedProfile = NULL;
+	int tolerance = -1;		// -1 keeps the profile's
+	float maxPixels = -1;
+
+	for (int i = 3; i < argc; i++) {
+		if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			forcedProfile = findProfile(argv[++i]);
+			if (forcedProfile == NULL) {
+				fprintf(stderr, "Unknown tolerance profile=%s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+			tolerance = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--max-pixels") == 0 && i + 1 < argc) {
+			maxPixels = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--diff-dir") == 0 && i + 1 < argc) {
+			diffDir = argv[++i];
+		} else {
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!setRenderResolution(GOLDEN_WIDTH, GOLDEN_HEIGHT)) {
+		return EXIT_FAILURE;
+	}
+	// The library sets up the engine for every path, it decodes every texture up front so no pose
+	// renders a placeholder
+	raycast_options_t options;
+	raycastGetDefaultOptions(&options);
+	raycast_engine_t *engine = raycastCreate(&options);
+	view_frames_t viewFrames;
+	const bool allocated = allocateViewFrames(&viewFrames);
+	if (engine == NULL || !allocated || !raycastLoadMap(engine, config.mapFile)) {
+		fprintf(stderr, "Could not set up the engine\n");
+		freeViewFrames(&viewFrames);
+		raycastDestroy(engine);
+		return EXIT_FAILURE;
+	}
+
+	const int width = GOLDEN_WIDTH;
+	const int height = GOLDEN_HEIGHT;
+	const size_t imageSize = (size_t)width * height * 3;
+	unsigned char *actual = malloc(imageSize);
+	unsigned char *expected = malloc(imageSize);
+	unsigned char *diff = malloc(imageSize);
+	int failures = 0;
+
+	for (size_t i = 0; i < NUM_POSES; i++) {
+		char fileName[MAX_FILE_NAME];
+		snprintf(fileName, sizeof(fileName), "%s/%s.ppm", referenceDir, poses[i].name);
+
+		renderPose(&poses[i]);
+		captureColorBuffer(actual);
+
+		if (record) {
+			if (!writePpm(fileName, actual, width, height)) {
+				failures++;
+			}
+			continue;
+		}
+
+		if (!readPpm(fileName, expected, width, height)) {
+			failures++;
+			continue;
+		}
+
+		tolerance_profile_t profile = forcedProfile != NULL ? *forcedProfile : *findProfile(poses[i].profile);
+		profile.tolerance = tolerance >= 0 ? tolerance : profile.tolerance;
+		profile.maxPixels = maxPixels >= 0 ? maxPixels : profile.maxPixels;
+		int maxDelta;
+		const int failedPixels = compareImages(actual, expected, diff, profile.tolerance, &maxDelta);
+		const bool passed = failedPixels <= (int)(profile.maxPixels * width * height);
+		printf("%-14s %s  %-7s %d pixels over tolerance %d, max channel delta %d\n", poses[i].name, passed ? "ok  " : "FAIL", profile.name, failedPixels, profile.tolerance, maxDelta);
+		if (maxDelta > 0) {
+			snprintf(fileName, sizeof(fileName), "%s/%s.diff.ppm", diffDir, poses[i].name);
+			writePpm(fileName, diff, width, height);
+		}
+		if (!passed | !checkViews(engine, &poses[i], &viewFrames)) {
+			failures++;
+		}
+	}
+
+	if (record) {
+		printf("Recorded %d reference images in %s\n", (int)NUM_POSES - failures, referenceDir);
+	} else {
+		printf("%d of %d poses passed\n", (int)NUM_POSES - failures, (int)NUM_POSES);
+	}
+
+	free(diff);
+	free(expected);
+	free(actual);
+	freeViewFrames(&viewFrames);
+	raycastDestroy(engine);
+	freeRays();
+	destroyColorBuffer();
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
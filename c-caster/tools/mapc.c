@@ -0,0 +1,431 @@
+// Map compiler: turns the text source of a level into the binary map file the engine loads
+// (see map.h), split into chunks. Every non-empty tile is solid. Maps of up to MAP_PVS_MAX_TILES
+// tiles get a potentially visible set for the guards (see pvs.h), the time it takes grows with the open space.
+//
+// Usage: raycast-mapc input.txt output.map
+// The source is whitespace separated, # starts a comment that runs to the end of the line:
+//   size COLS ROWS
+//   spawn X Y DEGREES
+//   tiles              followed by ROWS * COLS tile values from 0 to 255
+//   sprite X Y TEXTURE any number of times
+//   door COL ROW       any number of times, on a wall tile
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "map.h"
+
+#define MAX_TOKEN 32
+// Rays are cast from PVS_SAMPLES x PVS_SAMPLES points in every tile, PVS_RAYS_PER_TILE for every
+// tile of the map's diagonal, so neighboring rays are less than half a tile apart at its far end
+#define PVS_SAMPLES 3
+#define PVS_RAYS_PER_TILE 16
+
+typedef struct map_source_t {
+	map_header_t header;
+	uint8_t *tiles;
+	map_sprite_t *sprites;
+	int spriteCapacity;
+	map_door_t *doors;
+	int doorCapacity;
+	uint8_t *pvs;			// the section as written, see map.h
+} map_source_t;
+
+static bool readToken(FILE *file, char *token) {
+	int c;
+	for (;;) {
+		c = fgetc(file);
+		if (c == '#') {
+			while (c != '\n' && c != EOF) {
+				c = fgetc(file);
+			}
+		}
+		if (c == EOF) {
+			return false;
+		}
+		if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+			break;
+		}
+	}
+	int length = 0;
+	while (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '#') {
+		if (length < MAX_TOKEN - 1) {
+			token[length++] = c;
+		}
+		c = fgetc(file);
+	}
+	if (c == '#') {
+		ungetc(c, file);
+	}
+	token[length] = '\0';
+	return true;
+}
+
+static bool readNumber(FILE *file, double *number) {
+	char token[MAX_TOKEN];
+	char *end;
+	if (!readToken(file, token)) {
+		return false;
+	}
+	*number = strtod(token, &end);
+	return end != token && *end == '\0';
+}
+
+static bool addSprite(map_source_t *source, FILE *file) {
+	double x, y, texture;
+	if (!readNumber(file, &x) || !readNumber(file, &y) || !readNumber(file, &texture) || texture < 0) {
+		fprintf(stderr, "Expected sprite X Y TEXTURE\n");
+		return false;
+	}
+	if ((int)source->header.numSprites == source->spriteCapacity) {
+		source->spriteCapacity = source->spriteCapacity > 0 ? source->spriteCapacity * 2 : 16;
+		map_sprite_t *grown = realloc(source->sprites, source->spriteCapacity * sizeof(map_sprite_t));
+		if (grown == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			return false;
+		}
+		source->sprites = grown;
+	}
+	map_sprite_t *sprite = &source->sprites[source->header.numSprites++];
+	sprite->x = x;
+	sprite->y = y;
+	sprite->texture = texture;
+	return true;
+}
+
+static bool addDoor(map_source_t *source, FILE *file) {
+	double col, row;
+	if (!readNumber(file, &col) || !readNumber(file, &row) || col < 0 || row < 0) {
+		fprintf(stderr, "Expected door COL ROW\n");
+		return false;
+	}
+	if ((int)source->header.numDoors == source->doorCapacity) {
+		source->doorCapacity = source->doorCapacity > 0 ? source->doorCapacity * 2 : 16;
+		map_door_t *grown = realloc(source->doors, source->doorCapacity * sizeof(map_door_t));
+		if (grown == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			return false;
+		}
+		source->doors = grown;
+	}
+	map_door_t *door = &source->doors[source->header.numDoors++];
+	door->col = col;
+	door->row = row;
+	return true;
+}
+
+// Doors are checked once the tiles are known, they may come first
+static bool checkDoors(const map_source_t *source) {
+	for (uint32_t i = 0; i < source->header.numDoors; i++) {
+		const map_door_t *door = &source->doors[i];
+		if (door->col >= source->header.numCols || door->row >= source->header.numRows || source->tiles[(size_t)door->row * source->header.numCols + door->col] == 0) {
+			fprintf(stderr, "Door at %u, %u is not on a wall tile\n", door->col, door->row);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool readTiles(map_source_t *source, FILE *file) {
+	const size_t numCells = (size_t)source->header.numCols * source->header.numRows;
+	if (numCells == 0) {
+		fprintf(stderr, "Expected size COLS ROWS before the tiles\n");
+		return false;
+	}
+	source->tiles = malloc(numCells);
+	if (source->tiles == NULL) {
+		fprintf(stderr, "Out of memory for %zu tiles\n", numCells);
+		return false;
+	}
+	for (size_t i = 0; i < numCells; i++) {
+		double tile;
+		if (!readNumber(file, &tile) || tile < 0 || tile > 255) {
+			fprintf(stderr, "Expected %zu tiles from 0 to 255, tile %zu is missing or invalid\n", numCells, i);
+			return false;
+		}
+		source->tiles[i] = tile;
+	}
+	return true;
+}
+
+static bool readMapSource(const char *fileName, map_source_t *source) {
+	FILE *file = fopen(fileName, "r");
+	if (file == NULL) {
+		fprintf(stderr, "Could not open map source=%s\n", fileName);
+		return false;
+	}
+
+	char token[MAX_TOKEN];
+	bool valid = true;
+	while (valid && readToken(file, token)) {
+		double a = 0, b = 0, c = 0;
+		if (strcmp(token, "size") == 0) {
+			valid = source->tiles == NULL && readNumber(file, &a) && readNumber(file, &b) && a >= 1 && b >= 1 && a <= UINT16_MAX + 1 && b <= UINT16_MAX + 1;
+			source->header.numCols = a;
+			source->header.numRows = b;
+		} else if (strcmp(token, "spawn") == 0) {
+			valid = readNumber(file, &a) && readNumber(file, &b) && readNumber(file, &c);
+			source->header.spawnX = a;
+			source->header.spawnY = b;
+			source->header.spawnAngle = DEG_TO_RAD(c);
+		} else if (strcmp(token, "tiles") == 0) {
+			valid = source->tiles == NULL && readTiles(source, file);
+		} else if (strcmp(token, "sprite") == 0) {
+			valid = addSprite(source, file);
+		} else if (strcmp(token, "door") == 0) {
+			valid = addDoor(source, file);
+		} else {
+			fprintf(stderr, "Unknown keyword=%s\n", token);
+			valid = false;
+		}
+	}
+	fclose(file);
+
+	if (valid && source->tiles == NULL) {
+		fprintf(stderr, "Map source=%s has no tiles\n", fileName);
+		valid = false;
+	} else if (valid) {
+		valid = checkDoors(source);
+	}
+	if (!valid) {
+		fprintf(stderr, "Invalid map source=%s\n", fileName);
+	}
+	return valid;
+}
+
+static inline void setBit(uint8_t *set, size_t bit) {
+	set[bit >> 3] |= 1 << (bit & 7);
+}
+
+static inline bool getBit(const uint8_t *set, size_t bit) {
+	return (set[bit >> 3] >> (bit & 7)) & 1;
+}
+
+// Marks every tile the ray crosses in set, up to and including the first one that is not open
+static void castPvsRay(const map_source_t *source, const uint8_t *open, double x, double y, double angle, uint8_t *set) {
+	const int numCols = source->header.numCols;
+	const int numRows = source->header.numRows;
+	const double dirX = cos(angle);
+	const double dirY = sin(angle);
+	const int stepCol = dirX < 0 ? -1 : 1;
+	const int stepRow = dirY < 0 ? -1 : 1;
+	int col = (int)x;
+	int row = (int)y;
+	// Distances along the ray to the next vertical and horizontal grid line, and between them
+	const double deltaX = dirX != 0 ? fabs(1 / dirX) : INFINITY;
+	const double deltaY = dirY != 0 ? fabs(1 / dirY) : INFINITY;
+	double nextX = dirX != 0 ? (stepCol > 0 ? col + 1 - x : x - col) * deltaX : INFINITY;
+	double nextY = dirY != 0 ? (stepRow > 0 ? row + 1 - y : y - row) * deltaY : INFINITY;
+	for (;;) {
+		const size_t tile = (size_t)row * numCols + col;
+		setBit(set, tile);
+		if (!open[tile]) {
+			return;
+		}
+		if (nextX < nextY) {
+			col += stepCol;
+			nextX += deltaX;
+		} else {
+			row += stepRow;
+			nextY += deltaY;
+		}
+		if (col < 0 || col >= numCols || row < 0 || row >= numRows) {
+			return;
+		}
+	}
+}
+
+// Run-length encodes set into out, which has room for twice its size, returns the bytes written
+static size_t encodeSet(const uint8_t *set, size_t size, uint8_t *out) {
+	size_t length = 0;
+	for (size_t i = 0; i < size;) {
+		if (set[i] != 0) {
+			out[length++] = set[i++];
+			continue;
+		}
+		int run = 0;
+		while (i < size && set[i] == 0 && run < UINT8_MAX) {
+			run++;
+			i++;
+		}
+		out[length++] = 0;
+		out[length++] = run;
+	}
+	return length;
+}
+
+// Rays from a grid of points in every open tile mark the tiles they reach, with doors counted as
+// open since they may be. The sets are then made symmetric, and grown by a tile in every
+// direction since a sprite reaches into the tiles around its own.
+static bool buildPvs(map_source_t *source) {
+	const int numCols = source->header.numCols;
+	const int numRows = source->header.numRows;
+	const size_t numTiles = (size_t)numCols * numRows;
+	const size_t setBytes = (numTiles + 7) / 8;
+	if (numTiles > MAP_PVS_MAX_TILES) {
+		printf("No PVS for a map of more than %d tiles\n", MAP_PVS_MAX_TILES);
+		return true;
+	}
+
+	uint8_t *open = malloc(numTiles);
+	uint8_t *seen = calloc(numTiles, setBytes);
+	uint8_t *grown = malloc(setBytes);
+	uint8_t *encoded = malloc(numTiles * sizeof(uint32_t) + numTiles * 2 * setBytes);
+	bool built = open != NULL && seen != NULL && grown != NULL && encoded != NULL;
+	if (!built) {
+		fprintf(stderr, "Out of memory for the PVS\n");
+	}
+	for (size_t i = 0; built && i < numTiles; i++) {
+		open[i] = source->tiles[i] == 0;
+	}
+	for (uint32_t i = 0; built && i < source->header.numDoors; i++) {
+		open[(size_t)source->doors[i].row * numCols + source->doors[i].col] = 1;
+	}
+
+	const int numRays = (int)ceil(PVS_RAYS_PER_TILE * hypot(numCols, numRows));
+	for (size_t tile = 0; built && tile < numTiles; tile++) {
+		if (!open[tile]) {
+			continue;
+		}
+		for (int sampleRow = 0; sampleRow < PVS_SAMPLES; sampleRow++) {
+			for (int sampleCol = 0; sampleCol < PVS_SAMPLES; sampleCol++) {
+				const double x = tile % numCols + (sampleCol + 0.5) / PVS_SAMPLES;
+				const double y = tile / numCols + (sampleRow + 0.5) / PVS_SAMPLES;
+				for (int ray = 0; ray < numRays; ray++) {
+					castPvsRay(source, open, x, y, ray * TWO_PI / numRays, seen + tile * setBytes);
+				}
+			}
+		}
+	}
+
+	// What a tile sees also sees it
+	for (size_t tile = 0; built && tile < numTiles; tile++) {
+		for (size_t other = 0; open[tile] && other < numTiles; other++) {
+			if (open[other] && getBit(seen + tile * setBytes, other)) {
+				setBit(seen + other * setBytes, tile);
+			}
+		}
+	}
+
+	size_t size = numTiles * sizeof(uint32_t);
+	for (size_t tile = 0; built && tile < numTiles; tile++) {
+		uint32_t offset = MAP_PVS_NO_SET;
+		if (open[tile]) {
+			const uint8_t *set = seen + tile * setBytes;
+			memcpy(grown, set, setBytes);
+			for (size_t other = 0; other < numTiles; other++) {
+				if (!getBit(set, other)) {
+					continue;
+				}
+				const int row = other / numCols;
+				const int col = other % numCols;
+				for (int neighborRow = row - 1; neighborRow <= row + 1; neighborRow++) {
+					for (int neighborCol = col - 1; neighborCol <= col + 1; neighborCol++) {
+						if (neighborRow >= 0 && neighborRow < numRows && neighborCol >= 0 && neighborCol < numCols) {
+							setBit(grown, (size_t)neighborRow * numCols + neighborCol);
+						}
+					}
+				}
+			}
+			offset = size - numTiles * sizeof(uint32_t);
+			size += encodeSet(grown, setBytes, encoded + size);
+		}
+		memcpy(encoded + tile * sizeof(uint32_t), &offset, sizeof(offset));
+	}
+
+	free(open);
+	free(seen);
+	free(grown);
+	if (built) {
+		source->pvs = encoded;
+		source->header.pvsSize = size;
+	} else {
+		free(encoded);
+	}
+	return built;
+}
+
+// The tiles of the chunk at chunkRow, chunkCol, the ones past the edges of the map stay empty
+static void fillChunk(const map_source_t *source, uint32_t chunkRow, uint32_t chunkCol, map_chunk_t *chunk) {
+	memset(chunk, 0, sizeof(*chunk));
+	for (int row = 0; row < MAP_CHUNK_SIZE; row++) {
+		const uint32_t mapRow = (chunkRow << MAP_CHUNK_SHIFT) + row;
+		for (int col = 0; col < MAP_CHUNK_SIZE && mapRow < source->header.numRows; col++) {
+			const uint32_t mapCol = (chunkCol << MAP_CHUNK_SHIFT) + col;
+			if (mapCol >= source->header.numCols) {
+				break;
+			}
+			const int tile = row * MAP_CHUNK_SIZE + col;
+			chunk->tiles[tile] = source->tiles[(size_t)mapRow * source->header.numCols + mapCol];
+			if (chunk->tiles[tile] != 0) {
+				chunk->solidity[tile >> 3] |= 1 << (tile & 7);
+			}
+		}
+	}
+}
+
+static bool writeMap(const char *fileName, const map_source_t *source) {
+	const map_header_t *header = &source->header;
+	const uint32_t numChunkCols = getMapNumChunks(header->numCols);
+	const uint32_t numChunkRows = getMapNumChunks(header->numRows);
+
+	// Written next to the target and renamed over it, a running game keeps the old file mapped and
+	// truncating it in place would fault on its next read
+	char *tmpName = malloc(strlen(fileName) + sizeof(".tmp"));
+	if (tmpName == NULL) {
+		fprintf(stderr, "Could not write map=%s\n", fileName);
+		return false;
+	}
+	sprintf(tmpName, "%s.tmp", fileName);
+	FILE *file = fopen(tmpName, "wb");
+	bool written = file != NULL;
+	written = written && fwrite(header, sizeof(*header), 1, file) == 1;
+	for (uint32_t row = 0; row < numChunkRows && written; row++) {
+		for (uint32_t col = 0; col < numChunkCols && written; col++) {
+			map_chunk_t chunk;
+			fillChunk(source, row, col, &chunk);
+			written = fwrite(&chunk, sizeof(chunk), 1, file) == 1;
+		}
+	}
+	written = written && fwrite(source->sprites, sizeof(map_sprite_t), header->numSprites, file) == header->numSprites;
+	written = written && fwrite(source->doors, sizeof(map_door_t), header->numDoors, file) == header->numDoors;
+	written = written && fwrite(source->pvs, 1, header->pvsSize, file) == header->pvsSize;
+	if (file != NULL) {
+		written = fclose(file) == 0 && written;
+	}
+	written = written && rename(tmpName, fileName) == 0;
+	if (!written) {
+		fprintf(stderr, "Could not write map=%s\n", fileName);
+		remove(tmpName);
+		free(tmpName);
+		return false;
+	}
+	free(tmpName);
+
+	printf("Compiled %ux%u tiles in %u chunks, %u sprites, %u doors and a PVS of %u bytes into %s\n", header->numCols, header->numRows, numChunkCols * numChunkRows, header->numSprites, header->numDoors, header->pvsSize, fileName);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: raycast-mapc input.txt output.map\n");
+		return EXIT_FAILURE;
+	}
+
+	map_source_t source;
+	memset(&source, 0, sizeof(source));
+	memcpy(source.header.magic, MAP_FILE_MAGIC, 4);
+	source.header.version = MAP_FILE_VERSION;
+	source.header.byteOrder = MAP_FILE_BYTE_ORDER;
+	source.header.chunkSize = MAP_CHUNK_SIZE;
+
+	const bool compiled = readMapSource(argv[1], &source) && buildPvs(&source) && writeMap(argv[2], &source);
+	free(source.tiles);
+	free(source.sprites);
+	free(source.doors);
+	free(source.pvs);
+	return compiled ? EXIT_SUCCESS : EXIT_FAILURE;
+}
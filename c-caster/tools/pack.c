@@ -0,0 +1,124 @@
+// Texture packer: decodes the engine's textures once and writes their texels into a pack the
+// engine maps at startup instead of decoding the PNGs (see texpack.h).
+//
+// Usage: raycast-pack [--indexed] [output.pack]
+// Run it from c-caster/ like the game, the default output is ./textures.pack. The engine ignores
+// the pack for a PNG edited after it was written, so rerun it after editing an image. --indexed
+// stores each texture as a palette and a byte per texel, like the game's --indexed-textures.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "defs.h"
+#include "jobs.h"
+#include "texpack.h"
+#include "textures.h"
+
+static uint64_t alignOffset(uint64_t offset) {
+	return (offset + TEXPACK_ALIGNMENT - 1) & ~(uint64_t)(TEXPACK_ALIGNMENT - 1);
+}
+
+static bool writePadding(FILE *file, uint64_t *offset, uint64_t target) {
+	while (*offset < target) {
+		if (fputc(0, file) == EOF) {
+			return false;
+		}
+		(*offset)++;
+	}
+	return true;
+}
+
+static bool writeTexturePack(const char *fileName) {
+	const int numTextures = getTextureCount();
+	texpack_header_t header;
+	texpack_entry_t *entries = calloc(numTextures, sizeof(texpack_entry_t));
+	if (entries == NULL) {
+		fprintf(stderr, "Out of memory packing %d textures\n", numTextures);
+		return false;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TEXPACK_MAGIC, 4);
+	header.version = TEXPACK_VERSION;
+	header.byteOrder = TEXPACK_BYTE_ORDER;
+	header.numTextures = numTextures;
+
+	const size_t entriesSize = numTextures * sizeof(texpack_entry_t);
+	uint64_t offset = alignOffset(sizeof(header) + entriesSize);
+	for (int i = 0; i < numTextures; i++) {
+		const char *name = getTextureFileName(i);
+		const texture_t *texture = getTexture(i);
+		if (strlen(name) >= TEXPACK_NAME_LENGTH) {
+			fprintf(stderr, "Texture name=%s is too long for the pack\n", name);
+			free(entries);
+			return false;
+		}
+		strcpy(entries[i].name, name);
+		entries[i].width = texture->width;
+		entries[i].height = texture->height;
+		entries[i].offset = offset;
+		entries[i].paletteSize = texture->indices != NULL ? texture->paletteSize : 0;
+		offset = alignOffset(offset + getTextureSize(texture));
+	}
+
+	// Written next to the target and renamed over it, a running game samples the old pack in place
+	// and truncating it would fault on its next read
+	char *tmpName = malloc(strlen(fileName) + sizeof(".tmp"));
+	FILE *file = NULL;
+	if (tmpName != NULL) {
+		sprintf(tmpName, "%s.tmp", fileName);
+		file = fopen(tmpName, "wb");
+	}
+	if (file == NULL) {
+		fprintf(stderr, "Could not write texture pack=%s\n", fileName);
+		free(tmpName);
+		free(entries);
+		return false;
+	}
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(entries, entriesSize, 1, file) == 1;
+	offset = sizeof(header) + entriesSize;
+	for (int i = 0; i < numTextures && written; i++) {
+		const texture_t *texture = getTexture(i);
+		const size_t numTexels = (size_t)texture->width * texture->height;
+		written = writePadding(file, &offset, entries[i].offset);
+		if (texture->indices != NULL) {
+			written = written && fwrite(texture->palette, sizeof(color_t), texture->paletteSize, file) == (size_t)texture->paletteSize && fwrite(texture->indices, 1, numTexels, file) == numTexels;
+		} else {
+			written = written && fwrite(texture->texels, sizeof(color_t), numTexels, file) == numTexels;
+		}
+		offset += getTextureSize(texture);
+	}
+	written = fclose(file) == 0 && written;
+	written = written && rename(tmpName, fileName) == 0;
+	free(entries);
+	if (!written) {
+		fprintf(stderr, "Could not write texture pack=%s\n", fileName);
+		remove(tmpName);
+		free(tmpName);
+		return false;
+	}
+	free(tmpName);
+
+	printf("Packed %d textures into %s (%llu bytes)\n", numTextures, fileName, (unsigned long long)offset);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	int arg = 1;
+	if (arg < argc && strcmp(argv[arg], "--indexed") == 0) {
+		config.indexedTextures = true;
+		arg++;
+	}
+	if (argc - arg > 1) {
+		fprintf(stderr, "Usage: raycast-pack [--indexed] [output.pack]\n");
+		return EXIT_FAILURE;
+	}
+	const char *fileName = arg < argc ? argv[arg] : TEXTURE_PACK_FILE;
+
+	startJobWorkers(0);
+	const bool packed = decodeTextures() && writeTexturePack(fileName);
+	freeTextures();
+	stopJobWorkers();
+	return packed ? EXIT_SUCCESS : EXIT_FAILURE;
+}